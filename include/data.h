@@ -22,17 +22,22 @@
 #include <DynamicArray.h>
 #include <LittleFS.h>
 #include <ESP8266WiFi.h>
+#include <lwip/dns.h>
+#include <time.h>
+#include <coredecls.h>
 #include <PubSubClient.h>
+#include <AsyncMqttClient.h>
 #include <GyverPortal.h>
 
 #define NO_GLOBAL_BLYNK
+#define BLYNK_MSG_LIMIT 0 // pacing is done by BlynkManager, sendCmd() must not spin
 #define BLYNK_PRINT Serial
 #include <BlynkSimpleEsp8266.h>
 
 /* --- Ports --- */
 #define DS18B20_PORT D5
 #define BUTTON_PORT D6
-#define RELAY_PORT D7
+#define RELAY_PORTS {D7} // one per relay channel, boards with a second relay add its port (e.g. D1)
 
 /* --- Types --- */
 #define TYPE_BOOL 0
@@ -43,11 +48,23 @@
 #define TYPE_UINT32_T 5
 #define TYPE_INT32_T 6
 #define TYPE_FLOAT 7
+#define TYPE_STRING 8
+
+/* --- Build options --- */
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1 // tick latency instrumentation, 0 removes it from the build
+#endif
+
+#ifndef FORMAT_BENCHMARK_ENABLED
+#define FORMAT_BENCHMARK_ENABLED 0 // prints formatter timings to Serial at boot
+#endif
 
 /* --- Defaults --- */
 /* SensorsManager */
 #define DEFAULT_SLEEP_STATUS false
 #define DEFAULT_SLEEP_TIME 10 // min
+#define DEFAULT_TIME_ZONE "EET-2EEST,M3.5.0/3,M10.5.0/4" // POSIX TZ string
+#define DEFAULT_NTP_SERVER "pool.ntp.org"
 
 /* SensorsManager */
 #define DEFAULT_READ_DATA_TIME 5 // sec
@@ -62,6 +79,14 @@
 #define DEFAULT_RELAY_THERM_DELTA 1.0
 #define DEFAULT_RELAY_THERM_MODE 0
 #define DEFAULT_RELAY_THERM_ERROR_RELE_FLAG false
+#define DEFAULT_RELAY_PID_KP 200.0 // permille of the window per C
+#define DEFAULT_RELAY_PID_KI 10.0 // permille per C*min
+#define DEFAULT_RELAY_PID_KD 0.0 // permille per C/min
+#define DEFAULT_RELAY_PID_WINDOW 600 // sec
+#define DEFAULT_RELAY_MIN_ON_TIME 60 // sec
+#define DEFAULT_RELAY_MIN_OFF_TIME 60 // sec
+#define DEFAULT_RELAY_MAX_SWITCHES 30 // per hour, 0 - unlimited
+#define DEFAULT_RELAY_SCHEDULE_FLAG false
 
 /* NetworkManager */
 #define DEFAULT_NETWORK_MODE NETWORK_AUTO
@@ -74,12 +99,31 @@
 
 /* MqttManager */
 #define DEFAULT_MQTT_WORK_STATUS true
+#define DEFAULT_MQTT_TLS_STATUS true
+#define DEFAULT_MQTT_ASYNC_STATUS false
+#define DEFAULT_MQTT_PUBLISH_MODE MQTT_PUBLISH_SINGLE
+#define DEFAULT_MQTT_PREFIX "nztr/%06x" // filled with the chip id
+#define DEFAULT_MQTT_CLIENT_ID "nztr-%06x" // filled with the chip id
 
 /* --- Macroces --- */
+/* RTC memory, 4-byte blocks (0..31 are used by eboot during OTA) */
+#define RTC_NETWORK_CACHE_BLOCK 32
+#define RTC_MQTT_SESSION_BLOCK 48
+#define RTC_RELAY_STATS_BLOCK 80
+
 /* SystemManager */
+#define DIAGNOSTICS_PUBLISH_TIME 60 // sec
+#define DIAGNOSTICS_PAYLOAD_SIZE 320
 #define SAVE_SETTINGS_TIME 5 // sec
 #define WORK_TIME 18 // sec
-#define SETTINGS_BUFFER_SIZE 1100
+#define SETTINGS_ENTRY_SIZE 20 // key, separators and a number
+#define SETTINGS_ENTRIES_COUNT (3 + 1 + DS_SENSORS_MAX_COUNT * 4 + RELAY_CHANNELS_COUNT * 16 + 3 + 3 + NETWORK_WIFI_MAX_COUNT * 2 + 10 + 2 + BLYNK_LINKS_MAX * 2)
+#define SETTINGS_VALUES_SIZE (SYSTEM_TZ_SIZE + DS_SENSORS_MAX_COUNT * (DS_NAME_SIZE + 8 * 2) + RELAY_CHANNELS_COUNT * RELAY_PERIODS_MAX * sizeof(relay_period_t) * 2 \
+	+ NETWORK_SSID_PASS_SIZE * 2 * (1 + NETWORK_WIFI_MAX_COUNT) + MQTT_FINGERPRINT_SIZE + MQTT_PREFIX_SIZE + MQTT_SERVER_SIZE + MQTT_SSID_PASS_SIZE * 2 \
+	+ BLYNK_AUTH_SIZE + BLYNK_LINKS_MAX * BLYNK_ELEMENT_CODE_SIZE) // strings and hex encoded arrays
+#define SETTINGS_BUFFER_SIZE (SETTINGS_ENTRIES_COUNT * SETTINGS_ENTRY_SIZE + SETTINGS_VALUES_SIZE) // every key at its longest, about 4 KB
+#define SYSTEM_TZ_SIZE 48
+#define CLOCK_VALID_TIME 1704067200 // 2024-01-01, anything earlier means SNTP hasn't synced yet
 
 /* SensorsManager */
 #define UNSPECIFIED_STATUS 255
@@ -89,31 +133,150 @@
 /* RelayManager */
 #define RELAY_MODE_SIMPLE 0
 #define RELAY_MODE_THERM 1
+#define RELAY_MODE_PID 2
 
 #define RELAY_THERM_MODE_HEATING 0
 #define RELAY_THERM_MODE_COOLING 1
 
+#define RELAY_CHANNELS_COUNT 1 // must match RELAY_PORTS
+#define RELAY_CODE_SIZE 32
+#define RELAY_OUTPUT_UNKNOWN 0xFF
+
+#define RELAY_PID_GAIN_SCALE 100 // gains are kept in hundredths
+#define RELAY_PID_T_SCALE 100 // temperatures in hundredths of a degree
+#define RELAY_PID_DUTY_MAX 1000 // permille of the window
+#define RELAY_PID_D_FILTER 4 // derivative low pass, each sample moves 1/N of the way
+#define RELAY_PID_WINDOW_MIN 10 // sec
+#define RELAY_PID_WINDOW_MAX 3600 // sec
+#define RELAY_STATS_HOUR (60UL * 60 * 1000) // ms
+#define RELAY_STATS_DAY_HOURS 24
+#define RELAY_PERIODS_MAX 8 // per channel
+#define RELAY_TRANSITIONS_MAX (RELAY_PERIODS_MAX * 7)
+#define RELAY_SCHEDULE_SIZE 180 // text form, up to "1234567@23:59=-100.00 " per period
+#define RELAY_DAY_MINUTES (24 * 60)
+#define RELAY_WEEK_MINUTES (7 * RELAY_DAY_MINUTES)
+#define RELAY_SCHEDULE_DECIMALS 2 // setpoints are kept in RELAY_PID_T_SCALE
+
 /* NetworkManager */
 #define NETWORK_OFF 0
 #define NETWORK_STA 1
 #define NETWORK_AP_STA 2
 #define NETWORK_AUTO 3
-#define NETWORK_SSID_PASS_SIZE 15
-#define NETWORK_RECONNECT_TIME 20 // sec
+#define NETWORK_SSID_PASS_SIZE 33
+#define NETWORK_WIFI_MAX_COUNT 3
+#define NETWORK_RSSI_NONE -128
+#define NETWORK_FAIL_PENALTY 10 // dB per failed attempt
+#define NETWORK_FAILS_MAX 5
+#define NETWORK_SCAN_CACHE_TIME 60 // sec
+#define NETWORK_RECONNECT_MIN_TIME 5 // sec
+#define NETWORK_RECONNECT_MAX_TIME 300 // sec
+#define NETWORK_SCAN_TIMEOUT 10 // sec
+#define NETWORK_CONNECT_TIMEOUT 15 // sec
+#define NETWORK_FAST_CONNECT_TIMEOUT 3 // sec
+
+#define NETWORK_STATE_IDLE 0
+#define NETWORK_STATE_SCANNING 1
+#define NETWORK_STATE_ASSOCIATING 2
+#define NETWORK_STATE_DHCP 3
+#define NETWORK_STATE_CONNECTED 4
+#define NETWORK_STATE_BACKOFF 5
 
 /* Web */
 #define WEB_UPDATE_TIME 5 // sec
+#define WEB_VALUE_DECIMALS 1
 
 /* BlynkManager */
 #define BLYNK_LINKS_MAX 20
 #define BLYNK_AUTH_SIZE 35
 #define BLYNK_ELEMENT_CODE_SIZE 40
-#define BLYNK_RECONNECT_TIME 20 // sec
+#define BLYNK_RECONNECT_MIN_TIME 5 // sec
+#define BLYNK_RECONNECT_MAX_TIME 600 // sec
+#define BLYNK_DNS_TIMEOUT 5 // sec
+#define BLYNK_TCP_TIMEOUT 1500 // ms, client timeout bounding the blocking TCP connect
+#define BLYNK_SERVER_PORT BLYNK_DEFAULT_PORT // the only port tried, the library's 80/8080 fallback is refused
+#define BLYNK_LOGIN_TIMEOUT 5 // sec
+#define BLYNK_VALUE_DECIMALS 2
+#define BLYNK_FIXED_DECIMALS 2
+#define BLYNK_FIXED_SCALE 100
+#define BLYNK_SEND_RATE 10 // grouped flushes per sec
+#define BLYNK_SEND_INTERVAL (1000 / BLYNK_SEND_RATE) // ms
+#define BLYNK_VPINS_COUNT 256
+#define BLYNK_CODES_TABLE_SIZE 64 // power of two, over twice BLYNK_LINKS_MAX
+#define BLYNK_ROUTES_MAX 8
+#define BLYNK_NO_LINK 0xFF
+#define BLYNK_STAGE_IDLE 0
+#define BLYNK_STAGE_DNS 1
+#define BLYNK_STAGE_TCP 2
+#define BLYNK_STAGE_LOGIN 3
+#define BLYNK_DNS_PENDING 0
+#define BLYNK_DNS_DONE 1
+#define BLYNK_DNS_FAILED 2
 
 /* MqttManager */
 #define MQTT_SERVER_SIZE 60
 #define MQTT_SSID_PASS_SIZE 20
-#define MQTT_RECONNECT_TIME 20 // sec
+#define MQTT_FINGERPRINT_SIZE 60 // SHA1 as "AA:BB:..." or plain hex
+#define MQTT_RECONNECT_MIN_TIME 5 // sec
+#define MQTT_RECONNECT_MAX_TIME 600 // sec
+#define MQTT_BUFFER_SIZE 512
+#define MQTT_PREFIX_SIZE 32
+#define MQTT_CLIENT_ID_SIZE 24
+#define MQTT_ROUTES_MAX 8
+#define MQTT_ROUTES_TABLE_SIZE 16 // power of two, about twice MQTT_ROUTES_MAX
+#define MQTT_ROUTE_CODE_SIZE 40
+#define MQTT_FIXED_DECIMALS 2
+#define MQTT_FIXED_SCALE 100 // 10^MQTT_FIXED_DECIMALS
+#define MQTT_VALUE_DECIMALS 2
+#define MQTT_CONNECT_TIMEOUT 10 // sec, async transport
+#define MQTT_ACK_TIMEOUT 15 // sec, async transport
+#define MQTT_INFLIGHT_MAX 4 // unacknowledged QoS1 publishes, <= MQTT_QUEUE_SIZE
+#define MQTT_INBOUND_MAX 4
+#define MQTT_INBOUND_PAYLOAD_SIZE 16
+#define MQTT_TOPIC_SIZE 64
+#define MQTT_PAYLOAD_SIZE 160
+#define MQTT_BATCH_TOPIC "/system/data/batch"
+
+#define MQTT_PUBLISH_SINGLE 0 // one topic per reading
+#define MQTT_PUBLISH_BATCH 1 // one JSON payload per read cycle
+
+/* MqttQueue */
+#define MQTT_QUEUE_SIZE 8 // messages kept in RAM
+#define MQTT_QUEUE_SPILL_PATH "/mqtt_queue.nztr"
+#define MQTT_QUEUE_SPILL_TMP_PATH "/mqtt_queue.tmp"
+#define MQTT_QUEUE_SPILL_MAX_COUNT 2000 // messages kept on LittleFS
+#define MQTT_QUEUE_STAGING_SIZE 4 // messages waiting in RAM for the next spill write
+#define MQTT_QUEUE_FLUSH_INTERVAL 10000 // ms, staged messages are written at least this often
+#define MQTT_QUEUE_MAX_AGE 12 // hours
+#define MQTT_QUEUE_MAX_RETRIES 5
+#define MQTT_QUEUE_SEND_COUNT 4 // messages per send window
+#define MQTT_QUEUE_SEND_INTERVAL 50 // ms between send windows
+
+#define MQTT_MESSAGE_QUEUED 0
+#define MQTT_MESSAGE_SENT 1 // waiting for PUBACK
+#define MQTT_MESSAGE_DONE 2 // acknowledged or dropped, popped in order
+#define MQTT_MESSAGE_RESEND 3 // unacknowledged at disconnect, resent with DUP and the same packet id
+
+/* Profiler */
+#define PROFILER_SENSORS 0
+#define PROFILER_RELAY 1
+#define PROFILER_NETWORK 2
+#define PROFILER_WEB 3
+#define PROFILER_MQTT 4
+#define PROFILER_BLYNK 5
+#define PROFILER_LOOP 6
+#define PROFILER_MQTT_LATENCY 7 // enqueue to broker acknowledgement, in ms - queued messages wait far past 2^23 us
+#define PROFILER_BLYNK_LOGIN 8 // login sent to server response
+#define PROFILER_SLOTS_COUNT 9
+#define PROFILER_BUCKETS_COUNT 24 // bucket n holds samples < 2^n us
+
+/* Format */
+#define FORMAT_BUFFER_SIZE 16
+#define FORMAT_DECIMALS_MAX 6
+#define FORMAT_BENCHMARK_ROUNDS 1000
+
+/* ReconnectPolicy */
+#define RECONNECT_MIN_TIME 5 // sec
+#define RECONNECT_MAX_TIME 300 // sec
 
 /* --- Macro functions --- */
 #define SEC_TO_MLS(TIME) ((TIME) * 1000)
@@ -131,6 +294,16 @@
     (TYPE == TYPE_FLOAT)    ? *(float*)(POINTER) : *(uint8_t*)(POINTER) \
 )
 
+#if PROFILER_ENABLED
+#define PROFILE(PROFILER, SLOT, CALL) do { \
+	uint32_t profile_cycles = ESP.getCycleCount(); \
+	CALL; \
+	(PROFILER)->addSample(SLOT, (ESP.getCycleCount() - profile_cycles) / ESP.getCpuFreqMHz()); \
+} while (0)
+#else
+#define PROFILE(PROFILER, SLOT, CALL) CALL
+#endif
+
 #define TYPE_TO_LEN(TYPE) (\
     (TYPE == TYPE_BOOL)     ? sizeof(bool) : \
     (TYPE == TYPE_UINT8_T)  ? sizeof(uint8_t) : \
@@ -163,19 +336,224 @@ struct ds18b20_data_t {
 	uint8_t status;
 };
 
+struct network_wifi_t {
+	void operator=(const network_wifi_t& other) {
+		strcpy(ssid, other.ssid);
+		strcpy(pass, other.pass);
+
+		rssi = other.rssi;
+		channel = other.channel;
+		memcpy(bssid, other.bssid, sizeof(bssid));
+		fails = other.fails;
+	}
+
+	char ssid[NETWORK_SSID_PASS_SIZE];
+	char pass[NETWORK_SSID_PASS_SIZE];
+
+	int8_t rssi;
+	uint8_t channel;
+	uint8_t bssid[6];
+	uint8_t fails;
+};
+
+struct network_cache_t {
+	uint32_t crc;
+	char ssid[NETWORK_SSID_PASS_SIZE];
+	uint8_t bssid[6];
+	uint8_t channel;
+	uint32_t ip;
+	uint32_t gateway;
+	uint32_t subnet;
+	uint32_t dns;
+};
+
+struct mqtt_message_t {
+	char topic[MQTT_TOPIC_SIZE];
+	char payload[MQTT_PAYLOAD_SIZE];
+	uint32_t time; // millis() in the boot that queued it
+	uint32_t epoch; // clock time when queued, 0 - not known yet
+	uint32_t boot;
+	uint16_t packet_id;
+	uint8_t state;
+	uint8_t retries;
+};
+
+class IObserver;
+
+struct mqtt_session_cache_t {
+	uint32_t crc;
+	uint32_t server_hash;
+	BearSSL::Session session;
+};
+
+struct mqtt_route_t {
+	uint32_t hash;
+	char code[MQTT_ROUTE_CODE_SIZE];
+	IObserver* observer;
+	uint8_t type;
+};
+
+struct mqtt_stats_t {
+	uint32_t sent;
+	uint32_t acked;
+	uint32_t disconnects;
+};
+
+struct mqtt_inbound_t {
+	mqtt_route_t* route;
+	uint8_t length;
+	char payload[MQTT_INBOUND_PAYLOAD_SIZE];
+};
+
+struct relay_stats_t {
+	uint32_t cycles; // off to on switches
+	uint32_t on_time; // sec
+	uint16_t duty_hour; // permille over the last full hour
+	uint16_t duty_day; // permille over the last full day
+};
+
+struct relay_stats_cache_t {
+	uint32_t crc;
+	uint32_t elapsed; // ms into the current stats hour, deep sleeps included
+	uint8_t hours;
+	relay_stats_t stats[RELAY_CHANNELS_COUNT];
+	uint32_t on_time_ms[RELAY_CHANNELS_COUNT];
+	uint32_t on_time_hour[RELAY_CHANNELS_COUNT];
+	uint32_t on_time_day[RELAY_CHANNELS_COUNT];
+};
+
+struct __attribute__((packed)) relay_period_t {
+	uint8_t days; // bit 0 - Monday
+	uint16_t start; // minute of the day
+	int16_t t; // hundredths of a degree
+};
+
+struct relay_transition_t {
+	uint16_t minute; // of the week, from Monday 00:00
+	int16_t t; // hundredths of a degree
+};
+
+struct blynk_stats_t {
+	uint32_t sent; // written to the socket, Blynk doesn't acknowledge pin writes
+	uint32_t received;
+	uint32_t disconnects;
+	uint32_t login_time; // ms, last login round trip
+};
+
+struct blynk_route_t {
+	const char* code;
+	IObserver* observer;
+	uint8_t type;
+};
+
 struct blynk_link_t {
 	void operator=(const blynk_link_t& other) {
 		port = other.port;
 		strcpy(element_code, other.element_code);
+
+		code_hash = other.code_hash;
+		target = other.target;
 	}
 
 	uint8_t port;
 	char element_code[BLYNK_ELEMENT_CODE_SIZE];
+
+	uint32_t code_hash;
+	blynk_route_t* target; // settings code the pin writes to, NULL for data codes
 };
 
 
 class SystemManager;
 
+class ReconnectPolicy {
+public:
+	ReconnectPolicy();
+
+	void makeDefault();
+	void reset();
+
+	bool isReady();
+	void attempt();
+	void fail();
+	void success();
+	void retryNow();
+
+	uint16_t print(char* buffer, uint16_t size);
+
+	void setLimits(uint32_t min_time, uint32_t max_time);
+
+	uint32_t getAttempts();
+	uint32_t getTotalAttempts();
+	uint32_t getConnects();
+	uint32_t getConnectTime();
+	uint32_t getWaitTime();
+
+private:
+	/* --- settings --- */
+	uint32_t min_time;
+	uint32_t max_time;
+
+	/* --- variables --- */
+	uint32_t attempts;
+	uint32_t total_attempts;
+	uint32_t connects;
+	uint32_t connect_time;
+
+	uint32_t backoff_time;
+	uint32_t wait_time;
+	uint32_t wait_timer;
+	uint32_t series_timer;
+};
+
+class MqttQueue {
+public:
+	MqttQueue();
+
+	void makeDefault();
+	void begin();
+	void tick();
+
+	bool push(const char* topic, const char* payload);
+	mqtt_message_t* front();
+	mqtt_message_t* peek(uint8_t index);
+	void pop();
+	void drop();
+	void save();
+
+	mqtt_message_t* ack(uint16_t packet_id);
+	void markResend();
+	void clearResend();
+	bool isExpired(mqtt_message_t* message);
+
+	uint16_t getCount();
+	uint8_t getRamCount();
+	uint16_t getSpillCount();
+	uint32_t getPushed();
+	uint32_t getDropped();
+
+private:
+	void flush();
+	bool rewrite(bool ram_flag);
+	void refill();
+	void stampEpoch(mqtt_message_t* message);
+
+	/* --- variables --- */
+	mqtt_message_t ring[MQTT_QUEUE_SIZE];
+	uint8_t head;
+	uint8_t count;
+	uint32_t boot; // random per boot, tells whether a stored millis() stamp still means anything
+
+	// newer than everything on flash, written there in batches from tick()
+	mqtt_message_t staging[MQTT_QUEUE_STAGING_SIZE];
+	uint8_t staging_count;
+	uint32_t flush_timer;
+
+	uint16_t spill_count;
+	uint32_t spill_offset;
+	uint32_t pushed;
+	uint32_t dropped;
+};
+
 class IObserver {
 public:
 	virtual void addObserver(IObserver* observer) = 0;
@@ -275,52 +653,165 @@ public:
 
 	void writeSettings(char* buffer);
 	void readSettings(char* buffer);
+	void writeStatsCache(uint32_t sleep_time = 0);
 
 	void setSystemManager(SystemManager* system);
-	void setRelayFlag(bool relay_flag, bool sync_flag = false);
-
-	void setInvertFlag(bool invert_flag);
-	void setMode(uint8_t mode);
-
-	void setThermSensor(int8_t ds18b20_index);
-	void setThermSetT(float t);
-	void setThermDelta(float delta);
-	void setThermMode(uint8_t mode);
-	void setThermErrorRelayFlag(bool relay_flag);
-
-	bool getRelayFlag();
-
-	bool getInvertFlag();
-	uint8_t getMode();
+	void setRelayFlag(uint8_t channel, bool relay_flag, bool sync_flag = false);
+
+	void setInvertFlag(uint8_t channel, bool invert_flag);
+	void setMode(uint8_t channel, uint8_t mode);
+
+	void setThermSensor(uint8_t channel, int8_t ds18b20_index);
+	void setThermSetT(uint8_t channel, float t);
+	void setThermDelta(uint8_t channel, float delta);
+	void setThermMode(uint8_t channel, uint8_t mode);
+	void setThermErrorRelayFlag(uint8_t channel, bool relay_flag);
+
+	void setPidKp(uint8_t channel, float kp);
+	void setPidKi(uint8_t channel, float ki);
+	void setPidKd(uint8_t channel, float kd);
+	void setPidWindow(uint8_t channel, uint16_t window);
+
+	void setScheduleFlag(uint8_t channel, bool schedule_flag);
+	void setSchedule(uint8_t channel, String* schedule);
+	void setSchedule(uint8_t channel, const char* schedule);
+	void setOverride(uint8_t channel, float t, uint16_t time);
+	void cancelOverride(uint8_t channel);
+	void syncSchedule();
+
+	void setMinOnTime(uint16_t time);
+	void setMinOffTime(uint16_t time);
+	void setMaxSwitches(uint16_t count);
+
+	bool getRelayFlag(uint8_t channel);
+	relay_stats_t* getStats(uint8_t channel);
+	const char* getFlagCode(uint8_t channel);
+	float getTargetT(uint8_t channel);
+
+	bool getInvertFlag(uint8_t channel);
+	uint8_t getMode(uint8_t channel);
 	
-	uint8_t getThermStatus();
-	float getThermT();
-	int8_t getThermSensor();
-	float getThermSetT();
-	float getThermDelta();
-	uint8_t getThermMode();
-	bool getThermErrorRelayFlag();
+	uint8_t getThermStatus(uint8_t channel);
+	float getThermT(uint8_t channel);
+	int8_t getThermSensor(uint8_t channel);
+	float getThermSetT(uint8_t channel);
+	float getThermDelta(uint8_t channel);
+	uint8_t getThermMode(uint8_t channel);
+	bool getThermErrorRelayFlag(uint8_t channel);
+
+	float getPidKp(uint8_t channel);
+	float getPidKi(uint8_t channel);
+	float getPidKd(uint8_t channel);
+	uint16_t getPidWindow(uint8_t channel);
+	uint16_t getPidDuty(uint8_t channel);
+
+	bool getScheduleFlag(uint8_t channel);
+	uint16_t printSchedule(uint8_t channel, char* buffer, uint16_t size);
+	uint8_t getPeriodsCount(uint8_t channel);
+	bool getScheduleStatus(uint8_t channel);
+	bool getOverrideFlag(uint8_t channel);
+	float getOverrideT(uint8_t channel);
+	uint16_t getOverrideTime(uint8_t channel);
+
+	uint16_t getMinOnTime();
+	uint16_t getMinOffTime();
+	uint16_t getMaxSwitches();
 
 private:
 	void notifyObservers(String code, void* data, uint8_t type);
-	void relayTick();
+	void relayTick(uint8_t channel);
+	void thermTick(uint8_t channel, bool sample_flag = false);
+	void pidTick(uint8_t channel, bool sample_flag);
+	void pidWindowTick(uint8_t channel);
+	void resetPid(uint8_t channel);
+
+	void controlRelayFlag(uint8_t channel, bool relay_flag);
+	bool isSwitchAllowed(uint8_t channel);
+	void updateStats(uint8_t channel);
+	void statsTick();
+	void readStatsCache();
+
+	void compileSchedule(uint8_t channel);
+	void syncSchedule(uint8_t channel, time_t now);
+	void scheduleTick(uint8_t channel, time_t now);
+	time_t calcTransitionTime(uint8_t channel, time_t now);
+	uint16_t calcWeekMinute(struct tm* local);
+	void updateTarget(uint8_t channel);
+	bool isCorrectPeriod(relay_period_t* period);
+
+	bool isCorrectChannel(uint8_t channel);
+	String makeCode(const char* code, uint8_t channel);
+	String makeKey(const char* key, uint8_t channel);
 
 	/* --- classes & structures --- */
 	SystemManager* system;
 
 	/* --- settings --- */
-	bool invert_flag;
-	uint8_t mode;
+	// one entry per channel, parallel arrays keep each field packed for the evaluation pass
+	bool invert_flag[RELAY_CHANNELS_COUNT];
+	uint8_t mode[RELAY_CHANNELS_COUNT];
+
+	int8_t therm_sensor_index[RELAY_CHANNELS_COUNT];
+	float therm_set_t[RELAY_CHANNELS_COUNT];
+	float therm_delta[RELAY_CHANNELS_COUNT];
+	uint8_t therm_mode[RELAY_CHANNELS_COUNT];
+	bool therm_error_relay_flag[RELAY_CHANNELS_COUNT];
 
-	int8_t therm_sensor_index;
-	float therm_set_t;
-	float therm_delta;
-	uint8_t therm_mode;
-	bool therm_error_relay_flag;
+	int32_t pid_kp[RELAY_CHANNELS_COUNT]; // RELAY_PID_GAIN_SCALE
+	int32_t pid_ki[RELAY_CHANNELS_COUNT];
+	int32_t pid_kd[RELAY_CHANNELS_COUNT];
+	uint16_t pid_window[RELAY_CHANNELS_COUNT];
+
+	bool schedule_flag[RELAY_CHANNELS_COUNT];
+	relay_period_t periods[RELAY_CHANNELS_COUNT][RELAY_PERIODS_MAX];
+	uint8_t periods_count[RELAY_CHANNELS_COUNT];
+
+	uint16_t min_on_time;
+	uint16_t min_off_time;
+	uint16_t max_switches;
 
 	/* --- variables --- */
 	DynamicArray<IObserver*> observers;
-	bool relay_flag;
+	char flag_codes[RELAY_CHANNELS_COUNT][RELAY_CODE_SIZE];
+	bool begin_flag;
+
+	bool relay_flag[RELAY_CHANNELS_COUNT];
+	uint8_t output_level[RELAY_CHANNELS_COUNT]; // last level written to the port
+
+	int32_t pid_integral[RELAY_CHANNELS_COUNT]; // hundredths of a degree * sec
+	int32_t pid_derivative[RELAY_CHANNELS_COUNT]; // hundredths of a degree per min, filtered
+	int32_t pid_prev_t[RELAY_CHANNELS_COUNT];
+	uint32_t pid_timer[RELAY_CHANNELS_COUNT];
+	uint32_t pid_window_timer[RELAY_CHANNELS_COUNT];
+	uint16_t pid_duty[RELAY_CHANNELS_COUNT];
+
+	bool pending_flag[RELAY_CHANNELS_COUNT]; // a controller switch held back by the wear guard
+	bool pending_relay_flag[RELAY_CHANNELS_COUNT];
+	uint32_t switch_timer[RELAY_CHANNELS_COUNT];
+	uint32_t switch_tokens[RELAY_CHANNELS_COUNT]; // 1000 per switch
+	uint32_t switch_tokens_timer[RELAY_CHANNELS_COUNT];
+
+	relay_stats_t stats[RELAY_CHANNELS_COUNT];
+	uint32_t stats_timer[RELAY_CHANNELS_COUNT];
+	uint32_t on_time_ms[RELAY_CHANNELS_COUNT]; // not yet counted in on_time
+	uint32_t on_time_hour[RELAY_CHANNELS_COUNT]; // ms
+	uint32_t on_time_day[RELAY_CHANNELS_COUNT]; // ms
+	uint32_t stats_hour_timer;
+	uint8_t stats_hours;
+
+	// the periods compiled into a week sorted by start, a tick only looks at schedule_next
+	relay_transition_t transitions[RELAY_CHANNELS_COUNT][RELAY_TRANSITIONS_MAX];
+	uint8_t transitions_count[RELAY_CHANNELS_COUNT];
+	uint8_t schedule_index[RELAY_CHANNELS_COUNT]; // next transition
+	time_t schedule_next[RELAY_CHANNELS_COUNT]; // 0 - schedule not running
+	bool schedule_status[RELAY_CHANNELS_COUNT]; // the scheduled setpoint is in effect
+	int16_t schedule_t[RELAY_CHANNELS_COUNT]; // hundredths of a degree
+
+	bool override_flag[RELAY_CHANNELS_COUNT];
+	float override_t[RELAY_CHANNELS_COUNT];
+	uint16_t override_time[RELAY_CHANNELS_COUNT]; // min, 0 - until the next transition
+	uint32_t override_timer[RELAY_CHANNELS_COUNT];
+	float target_t[RELAY_CHANNELS_COUNT]; // last published
 };
 
 class Web {
@@ -337,6 +828,7 @@ private:
 	/* --- functions --- */
 	void updateSensorsBlock();
 	void updateBlynkBlock();
+	const char* formatT(float t, bool degrees = true);
 
 	/* --- classes & structures --- */
 	GyverPortal ui;
@@ -353,6 +845,7 @@ private:
 	
 	/* --- variables --- */
 	SystemManager* system;
+	char format_buffer[FORMAT_BUFFER_SIZE];
 
 	String update_codes;
 	sensors_block_t sensors_block;
@@ -384,40 +877,83 @@ public:
 
 	void setSystemManager(SystemManager* system);
 
+	bool addWifi();
+	bool deleteWifi(uint8_t index);
+	bool saveWifi(const char* ssid, const char* pass);
+
 	void setMode(uint8_t mode);
-	void setWifi(String* ssid, String* pass);
-	void setWifi(const char* ssid, const char* pass);
+	void setWifi(uint8_t index, String* ssid, String* pass);
+	void setWifi(uint8_t index, const char* ssid, const char* pass);
 	void setAp(String* ssid, String* pass);
 	void setAp(const char* ssid, const char* pass);
 
 	wl_status_t getStatus();
+	uint8_t getState();
+	ReconnectPolicy* getReconnectPolicy();
 
 	uint8_t getMode();
-	char* getWifiSsid();
-	char* getWifiPass();
+	uint8_t getWifiCount();
+	int8_t getWifiIndex();
+	char* getWifiSsid(uint8_t index);
+	char* getWifiPass(uint8_t index);
+	int8_t getWifiRssi(uint8_t index);
+	uint8_t getWifiFails(uint8_t index);
 	char* getApSsid();
 	char* getApPass();
 
 private:
+	void notifyObservers(String code, void* data, uint8_t type);
+
 	void off();
+	void connectTick();
+	void setState(uint8_t state);
+	int8_t scanSsidIndex(const char* ssid, int16_t count);
+	void updateScanResults(int16_t count);
+	bool connectBest();
+	bool isCorrectWifiIndex(uint8_t index);
+
+	bool isCacheValid(const char* ssid);
+	void readCache();
+	void writeCache();
+	void clearCache();
 
 	/* --- classes & structures --- */
 	Web web;
 
+	WiFiEventHandler connected_handler;
+	WiFiEventHandler got_ip_handler;
+	WiFiEventHandler disconnected_handler;
+	ReconnectPolicy reconnect;
+
 	/* --- settings --- */
 	uint8_t mode;
 
-	char ssid_sta[NETWORK_SSID_PASS_SIZE];
-	char pass_sta[NETWORK_SSID_PASS_SIZE];
+	DynamicArray<network_wifi_t> wifi_list;
 	char ssid_ap[NETWORK_SSID_PASS_SIZE];
 	char pass_ap[NETWORK_SSID_PASS_SIZE];
 
 	/* --- variables --- */
+	DynamicArray<IObserver*> observers;
 	SystemManager* system;
 
+	char connect_ssid[NETWORK_SSID_PASS_SIZE];
+	char connect_pass[NETWORK_SSID_PASS_SIZE];
+	uint8_t connect_time;
+	bool connect_auto_save;
+	bool connect_request;
+
+	network_cache_t cache;
+	bool cache_attempt;
+
+	int8_t wifi_index;
+	uint8_t wifi_tried_mask;
+	uint32_t scan_timer;
+	bool connected_flag;
+
 	bool reset_request;
-	bool tick_allow;
-	uint32_t wifi_reconnect_timer;
+	volatile uint8_t state;
+	volatile int16_t scan_count;
+	uint32_t state_timer;
 };
 
 class MqttManager : public IManager {
@@ -437,16 +973,38 @@ public:
 	void writeSettings(char* buffer);
 	void readSettings(char* buffer);
 
+	bool addRoute(const char* code, IObserver* observer, uint8_t type);
+
 	void setSystemManager(SystemManager* system);
 
 	void setWorkFlag(bool work_flag);
+	void setAsyncFlag(bool async_flag);
+	void setTlsFlag(bool tls_flag);
+	void setFingerprint(String* mqtt_fingerprint);
+	void setFingerprint(const char* mqtt_fingerprint);
+	void setPublishMode(uint8_t publish_mode);
+	void setPrefix(String* mqtt_prefix);
+	void setPrefix(const char* mqtt_prefix);
 	void setServer(String* mqtt_server, uint16_t mqtt_port);
 	void setServer(const char* mqtt_server, uint16_t mqtt_port);
 	void setAccess(String* mqtt_ssid, String* mqtt_pass);
 	void setAccess(const char* mqtt_ssid, const char* mqtt_pass);
 
+	void saveQueue();
+	void forceDisconnect();
+	uint16_t printStats(char* buffer, uint16_t size);
+
 	int8_t getStatus();
+	ReconnectPolicy* getReconnectPolicy();
+	MqttQueue* getQueue();
+	mqtt_stats_t* getStats();
 	bool getWorkFlag();
+	bool getAsyncFlag();
+	bool getTlsFlag();
+	char* getFingerprint();
+	uint8_t getPublishMode();
+	char* getPrefix();
+	char* getClientId();
 
 	char* getServer();
 	uint16_t getPort();
@@ -458,13 +1016,44 @@ private:
 
 	void off();
 	void connect();
+	void sendQueue();
+	bool publish(const char* topic, const char* payload);
+	void pushBatch();
+	void completeMessage(mqtt_message_t* message);
+
+	void asyncTick();
+	void asyncConnect();
+	void asyncSendQueue();
+	void pushInbound(mqtt_route_t* route, const char* payload, uint16_t length);
+	void handleInbound();
+	void handleAcks();
+	bool makeTopic(char* buffer, const char* code);
+
+	mqtt_route_t* topicToRoute(const char* topic);
+	mqtt_route_t* findRoute(const char* code);
+	void handleRoute(mqtt_route_t* route, const char* payload, uint16_t length);
+
+	uint32_t getServerHash();
+	void readSession();
+	void writeSession();
 
 	/* --- classes & structures --- */
 	WiFiClientSecure esp_client;
+	WiFiClient tcp_client;
+	BearSSL::Session session;
 	PubSubClient mqtt_client;
+	AsyncMqttClient async_client;
+	ReconnectPolicy reconnect;
+	MqttQueue queue;
+	mqtt_stats_t stats;
 
 	/* --- settings --- */
 	bool work_flag;
+	bool async_flag;
+	bool tls_flag;
+	char mqtt_fingerprint[MQTT_FINGERPRINT_SIZE];
+	uint8_t publish_mode;
+	char mqtt_prefix[MQTT_PREFIX_SIZE];
 
 	char mqtt_server[MQTT_SERVER_SIZE];
 	uint16_t mqtt_port;
@@ -473,10 +1062,33 @@ private:
 
 	/* --- variables --- */
 	DynamicArray<IObserver*> observers;
+	mqtt_route_t routes[MQTT_ROUTES_TABLE_SIZE];
+	uint8_t routes_count;
 	SystemManager* system;
 
 	bool reset_request;
-	uint32_t reconnect_timer;
+	uint32_t send_timer;
+
+	mqtt_inbound_t inbound[MQTT_INBOUND_MAX];
+	volatile uint8_t inbound_head;
+	volatile uint8_t inbound_count;
+	volatile uint16_t acks[MQTT_INFLIGHT_MAX]; // PUBACK packet ids, the in-flight window bounds them
+	volatile uint8_t acks_head;
+	volatile uint8_t acks_count;
+	char client_id[MQTT_CLIENT_ID_SIZE];
+
+	volatile bool connect_event;
+	volatile bool disconnect_event;
+	volatile bool session_present;
+	uint32_t connect_timer;
+	uint32_t ack_timer;
+	bool connected_flag;
+};
+
+class BlynkTcpClient : public WiFiClient {
+public:
+	using WiFiClient::connect;
+	int connect(IPAddress ip, uint16_t port) override;
 };
 
 class BlynkManager : public IManager {
@@ -500,6 +1112,9 @@ public:
 	bool deleteLink(uint8_t index);
 	bool deleteLink(String code);
 	bool modifyLinkElementCode(String previous_code, String new_code);
+	bool addRoute(const char* code, IObserver* observer, uint8_t type);
+	void forceDisconnect();
+	uint16_t printStats(char* buffer, uint16_t size);
 
 	void setSystemManager(SystemManager* system);
 
@@ -510,6 +1125,9 @@ public:
 	void setLinkElementCode(uint8_t index, String code);
 
 	bool getStatus();
+	ReconnectPolicy* getReconnectPolicy();
+	blynk_stats_t* getStats();
+	uint8_t getPendingCount();
 
 	bool getWorkFlag();
 	char* getAuth();
@@ -523,16 +1141,28 @@ private:
 
 	bool isCorrectLinkIndex(uint8_t index);
 	int8_t scanLinkIndex(String element_code);
+	uint8_t findLink(const char* element_code);
+	void updateIndexes();
+	void handleWrite(uint8_t port, const BlynkParam& param);
+	void dispatchWrite(blynk_link_t* link, const char* code, void* data, uint8_t type);
 
 	void off();
 	void connect();
+	void setConnectStage(uint8_t stage);
+	void failConnect(const char* reason);
+	static void dnsFound(const char* name, const ip_addr_t* ip, void* arg);
+
+	void addWrite(uint8_t link_index, void* data, uint8_t type);
+	void sendWrites();
 
 	friend BLYNK_WRITE_DEFAULT();
 
 	/* --- classes & structures --- */
-	static WiFiClient _blynkWifiClient;
+	static BlynkTcpClient _blynkWifiClient;
   	static BlynkArduinoClient _blynkTransport;
   	static BlynkWifi Blynk;
+	ReconnectPolicy reconnect;
+	blynk_stats_t stats;
 	
 	/* --- settings --- */
 	bool work_flag;
@@ -541,12 +1171,56 @@ private:
 	/* --- variables --- */
 	DynamicArray<IObserver*> observers;
 	DynamicArray<blynk_link_t> links;
+	blynk_route_t routes[BLYNK_ROUTES_MAX];
+	uint8_t routes_count;
+	uint8_t vpin_index[BLYNK_VPINS_COUNT];
+	uint8_t code_index[BLYNK_CODES_TABLE_SIZE];
 	SystemManager* system;
 
 	bool reset_request;
-	uint32_t reconnect_timer;
+	uint8_t connect_stage;
+	uint32_t connect_timer; // start of the current stage
+	IPAddress server_ip;
+	volatile uint8_t dns_status;
+	bool connected_flag;
+
+	char values[BLYNK_LINKS_MAX][FORMAT_BUFFER_SIZE]; // latest value per link
+	uint32_t dirty_mask; // bit per link, set until its value is sent
+	uint32_t send_timer;
 };
 
+#if PROFILER_ENABLED
+struct profiler_slot_t {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint32_t buckets[PROFILER_BUCKETS_COUNT];
+};
+
+class Profiler {
+public:
+	Profiler();
+
+	void makeDefault();
+	void addSample(uint8_t slot, uint32_t time);
+	uint16_t printSlot(uint8_t slot, char* buffer, uint16_t size);
+
+	const char* getSlotName(uint8_t slot);
+	uint32_t getCount(uint8_t slot);
+	uint32_t getMin(uint8_t slot);
+	uint32_t getMax(uint8_t slot);
+	uint32_t getPercentile(uint8_t slot, uint8_t percent);
+	uint32_t getBucket(uint8_t slot, uint8_t bucket);
+
+private:
+	bool isCorrectSlot(uint8_t slot);
+	uint8_t timeToBucket(uint32_t time);
+
+	/* --- variables --- */
+	profiler_slot_t slots[PROFILER_SLOTS_COUNT];
+};
+#endif
+
 class SystemManager : public IManager {
 public:
 	SystemManager();
@@ -572,6 +1246,8 @@ public:
 
 	void setSleepFlag(bool sleep_flag);
 	void setSleepTime(uint8_t sleep_time);
+	void setTimeZone(String* tz);
+	void setTimeZone(const char* tz);
 
 	void setSensorsReadFlag(bool flag);
 	void setMqttSentFlag(bool flag);
@@ -582,9 +1258,14 @@ public:
 	NetworkManager* getNetworkManager();
 	MqttManager* getMqttManager();
 	BlynkManager* getBlynkManager();
+#if PROFILER_ENABLED
+	Profiler* getProfiler();
+#endif
 
 	bool getSleepFlag();
 	uint8_t getSleepTime();
+	const char* getTimeZone();
+	static time_t getClockTime();
 
 	bool getSensorsReadFlag();
 	bool getMqttSentFlag();
@@ -595,6 +1276,9 @@ private:
 
 	void saveSettings(bool ignore_flag = false);
 	void readSettings();
+	void publishDiagnostics();
+	void sleep();
+	static void clockSynced();
 
 	bool getButtonStatus();
 
@@ -604,6 +1288,9 @@ private:
 	NetworkManager network;
 	MqttManager mqtt;
 	BlynkManager blynk;
+#if PROFILER_ENABLED
+	Profiler profiler;
+#endif
 
 	struct SleepReqs {
 		bool sensors_read_flag = false;
@@ -626,17 +1313,36 @@ private:
 	/* --- settings --- */
 	bool sleep_flag;
 	uint8_t sleep_time;
+	char tz[SYSTEM_TZ_SIZE];
 
 	/* --- variables --- */
 	DynamicArray<IObserver*> observers;
 	SleepReqs sleep_reqs;
+	static volatile bool clock_sync_flag; // set from the SNTP callback, handled in tick()
+	bool clock_config_request;
 
 	bool save_settings_request;
 	uint32_t save_settings_timer;
 	uint32_t work_timer;
+	uint32_t diagnostics_publish_timer;
 };
 
 
+uint32_t calcCrc32(const void* data, uint16_t length);
+uint32_t calcHash(const char* str);
+bool parseInt(const char* str, uint16_t length, int32_t* value);
+bool parseBool(const char* str, uint16_t length, bool* value);
+bool parseFixed(const char* str, uint16_t length, int32_t* value, uint8_t decimals);
+
+uint8_t formatUint(char* buffer, uint8_t size, uint32_t value);
+uint8_t formatInt(char* buffer, uint8_t size, int32_t value);
+uint8_t formatFixed(char* buffer, uint8_t size, int32_t value, uint8_t decimals);
+uint8_t formatFloat(char* buffer, uint8_t size, float value, uint8_t decimals);
+uint8_t formatValue(char* buffer, uint8_t size, void* data, uint8_t type, uint8_t decimals);
+#if FORMAT_BENCHMARK_ENABLED
+void benchmarkFormat();
+#endif
+
 template <class T1, class T2, class T3, class T4>
 T1 smartIncr(T1& value, T2 incr_step, T3 min, T4 max) {
 	if (!incr_step) {
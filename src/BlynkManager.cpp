@@ -22,9 +22,20 @@ void BlynkManager::makeDefault() {
 	
 	observers.clear();
 	links.clear();
+	routes_count = 0;
+	updateIndexes();
+	reconnect.setLimits(SEC_TO_MLS(BLYNK_RECONNECT_MIN_TIME), SEC_TO_MLS(BLYNK_RECONNECT_MAX_TIME));
+	reconnect.makeDefault();
 
 	reset_request = true;
-	reconnect_timer = 0;
+	connect_stage = BLYNK_STAGE_IDLE;
+	connect_timer = 0;
+	dns_status = BLYNK_DNS_PENDING;
+	connected_flag = false;
+	memset(&stats, 0, sizeof(stats));
+
+	dirty_mask = 0;
+	send_timer = 0;
 }
 
 void BlynkManager::begin() {
@@ -41,15 +52,39 @@ void BlynkManager::tick() {
 		off();
 	}
 
+	if (connected_flag && !getStatus()) {
+		stats.disconnects++;
+	}
+	connected_flag = getStatus();
+
 	if (!getWorkFlag() || !*getAuth() || network->getStatus() != WL_CONNECTED) {
 		return;
 	}
 
 	if (!getStatus()) {
 		connect();
+
+		// only the login stage needs Blynk.run(), elsewhere it would start its own blocking reconnects
+		if (connect_stage != BLYNK_STAGE_LOGIN) {
+			return;
+		}
+	}
+
+	else if (connect_stage != BLYNK_STAGE_IDLE) {
+		stats.login_time = millis() - connect_timer;
+#if PROFILER_ENABLED
+		system->getProfiler()->addSample(PROFILER_BLYNK_LOGIN, min(stats.login_time, (uint32_t) (UINT32_MAX / 1000)) * 1000);
+#endif
+
+		setConnectStage(BLYNK_STAGE_IDLE);
+		reconnect.success();
 	}
 
 	Blynk.run();
+
+	if (getStatus()) {
+		sendWrites();
+	}
 }
 
 void BlynkManager::addElementCodes(DynamicArray<String>* array) {
@@ -66,15 +101,20 @@ void BlynkManager::addObserver(IObserver* observer) {
 }
 
 bool BlynkManager::handleEvent(const char* code, void* data, uint8_t type) {
+	if (!strcmp(code, "/network/data/connected")) {
+		if (*(bool*) data) {
+			reconnect.retryNow();
+		}
+
+		return false;
+	}
+
 	if (getWorkFlag() && getStatus()) {
-		for (uint8_t i = 0;i < getLinksCount();i++) {
-			if (!strcmp(getLinkElementCode(i), code)) {
-				Blynk.virtualWrite(getLinkPort(i), POINTER_TO_TYPE(data, type));
-				delay(10);
+		uint8_t link_index = findLink(code);
 
-				system->setBlynkSentFlag(true);
-				return true;
-			}
+		if (link_index != BLYNK_NO_LINK) {
+			addWrite(link_index, data, type);
+			return true;
 		}
 	}
 
@@ -119,6 +159,7 @@ void BlynkManager::readSettings(char* buffer) {
 
 bool BlynkManager::addLink() {
 	if (links.add()) {
+		links[links.size() - 1].element_code[0] = '\0';
 		setLinkPort(links.size() - 1, links.size() - 1);
 
 		return true;
@@ -129,6 +170,7 @@ bool BlynkManager::addLink() {
 
 bool BlynkManager::deleteLink(uint8_t index) {
 	if (links.del(index)) {
+		updateIndexes();
 		return true;
 	}
 
@@ -150,6 +192,39 @@ bool BlynkManager::modifyLinkElementCode(String previous_code, String new_code)
 	return true;
 }
 
+bool BlynkManager::addRoute(const char* code, IObserver* observer, uint8_t type) {
+	if (code == NULL || observer == NULL || routes_count >= BLYNK_ROUTES_MAX) {
+		return false;
+	}
+
+	routes[routes_count].code = code;
+	routes[routes_count].observer = observer;
+	routes[routes_count].type = type;
+	routes_count++;
+
+	updateIndexes();
+	return true;
+}
+
+void BlynkManager::forceDisconnect() {
+	Serial.println("blynk force disconnect");
+
+	// the policy is left alone, the next tick reconnects as after a real outage
+	Blynk.disconnect();
+	setConnectStage(BLYNK_STAGE_IDLE);
+}
+
+uint16_t BlynkManager::printStats(char* buffer, uint16_t size) {
+	if (buffer == NULL || !size) {
+		return 0;
+	}
+
+	int length = snprintf(buffer, size, "{\"t\":%u,\"out\":%u,\"in\":%u,\"pending\":%u,\"disc\":%u,\"login\":%u}",
+		millis() / 1000, stats.sent, stats.received, getPendingCount(), stats.disconnects, stats.login_time);
+
+	return (length < size) ? length : size - 1;
+}
+
 
 void BlynkManager::setSystemManager(SystemManager* system) {
 	this->system = system;
@@ -176,6 +251,7 @@ void BlynkManager::setLinkPort(uint8_t index, uint8_t port) {
 	}
 
 	links[index].port = port;
+	updateIndexes();
 }
 
 void BlynkManager::setLinkElementCode(uint8_t index, String code) {
@@ -184,6 +260,7 @@ void BlynkManager::setLinkElementCode(uint8_t index, String code) {
 	}
 
 	strcpy(links[index].element_code, code.c_str());
+	updateIndexes();
 }
 
 
@@ -191,6 +268,18 @@ bool BlynkManager::getStatus() {
 	return Blynk.connected();
 }
 
+ReconnectPolicy* BlynkManager::getReconnectPolicy() {
+	return &reconnect;
+}
+
+blynk_stats_t* BlynkManager::getStats() {
+	return &stats;
+}
+
+uint8_t BlynkManager::getPendingCount() {
+	return __builtin_popcount(dirty_mask);
+}
+
 
 bool BlynkManager::getWorkFlag() {
 	return work_flag;
@@ -253,9 +342,155 @@ int8_t BlynkManager::scanLinkIndex(String element_code) {
 	return -1;
 }
 
+uint8_t BlynkManager::findLink(const char* element_code) {
+	uint32_t hash = calcHash(element_code);
+
+	for (uint8_t i = 0;i < BLYNK_CODES_TABLE_SIZE;i++) {
+		uint8_t link_index = code_index[(hash + i) & (BLYNK_CODES_TABLE_SIZE - 1)];
+
+		if (link_index == BLYNK_NO_LINK) {
+			break;
+		}
+
+		if (links[link_index].code_hash == hash && !strcmp(links[link_index].element_code, element_code)) {
+			return link_index;
+		}
+	}
+
+	return BLYNK_NO_LINK;
+}
+
+void BlynkManager::updateIndexes() {
+	// slots follow link indexes, which just may have shifted
+	dirty_mask = 0;
+
+	memset(vpin_index, BLYNK_NO_LINK, sizeof(vpin_index));
+	memset(code_index, BLYNK_NO_LINK, sizeof(code_index));
+
+	for (uint8_t i = 0;i < links.size();i++) {
+		blynk_link_t* link = &links[i];
+
+		link->code_hash = calcHash(link->element_code);
+		link->target = NULL;
+
+		for (uint8_t j = 0;j < routes_count;j++) {
+			if (!strcmp(routes[j].code, link->element_code)) {
+				link->target = &routes[j];
+				break;
+			}
+		}
+
+		// the first link keeps the pin and the code, like the linear scans did
+		if (vpin_index[link->port] == BLYNK_NO_LINK) {
+			vpin_index[link->port] = i;
+		}
+
+		if (findLink(link->element_code) != BLYNK_NO_LINK) {
+			continue;
+		}
+
+		for (uint8_t j = 0;j < BLYNK_CODES_TABLE_SIZE;j++) {
+			uint8_t* slot = &code_index[(link->code_hash + j) & (BLYNK_CODES_TABLE_SIZE - 1)];
+
+			if (*slot == BLYNK_NO_LINK) {
+				*slot = i;
+				break;
+			}
+		}
+	}
+}
+
+void BlynkManager::handleWrite(uint8_t port, const BlynkParam& param) {
+	uint8_t link_index = vpin_index[port];
+
+	if (link_index == BLYNK_NO_LINK) {
+		return;
+	}
+
+	blynk_link_t* link = &links[link_index];
+	stats.received++;
+
+	// only the first value of the NUL separated list, parsed in place without atof()
+	const char* str = param.asStr();
+	uint16_t length = strnlen(str, param.getLength());
+
+	uint8_t type = (link->target != NULL) ? link->target->type : TYPE_FLOAT;
+	const char* code = (link->target != NULL) ? link->target->code : link->element_code;
+
+	if (type == TYPE_BOOL) {
+		bool data;
+
+		if (parseBool(str, length, &data)) {
+			dispatchWrite(link, code, &data, TYPE_BOOL);
+		}
+	}
+	else if (type == TYPE_FLOAT) {
+		int32_t fixed;
+
+		if (parseFixed(str, length, &fixed, BLYNK_FIXED_DECIMALS)) {
+			float data = (float) fixed / BLYNK_FIXED_SCALE;
+			dispatchWrite(link, code, &data, TYPE_FLOAT);
+		}
+	}
+	else {
+		int32_t data;
+
+		if (parseInt(str, length, &data)) {
+			dispatchWrite(link, code, &data, TYPE_INT32_T);
+		}
+	}
+}
+
+void BlynkManager::dispatchWrite(blynk_link_t* link, const char* code, void* data, uint8_t type) {
+	if (link->target != NULL) {
+		link->target->observer->handleEvent(code, data, type);
+	}
+	else {
+		notifyObservers(code, data, type);
+	}
+}
+
 
 void BlynkManager::off() {
 	Blynk.disconnect();
+
+	setConnectStage(BLYNK_STAGE_IDLE);
+	reconnect.reset();
+}
+
+void BlynkManager::addWrite(uint8_t link_index, void* data, uint8_t type) {
+	if (link_index >= BLYNK_LINKS_MAX) {
+		return;
+	}
+
+	// a pin written again before its turn only keeps the newest value
+	formatValue(values[link_index], FORMAT_BUFFER_SIZE, data, type, BLYNK_VALUE_DECIMALS);
+	dirty_mask |= 1UL << link_index;
+}
+
+void BlynkManager::sendWrites() {
+	if (!dirty_mask) {
+		return;
+	}
+
+	if (millis() - send_timer < BLYNK_SEND_INTERVAL) {
+		return;
+	}
+
+	// every dirty pin goes out in one group frame, the interval paces the frames
+	Blynk.beginGroup();
+	for (uint8_t i = 0;i < BLYNK_LINKS_MAX;i++) {
+		if (dirty_mask & (1UL << i)) {
+			Blynk.virtualWrite(getLinkPort(i), values[i]);
+			stats.sent++;
+		}
+	}
+	Blynk.endGroup();
+
+	dirty_mask = 0;
+	send_timer = millis();
+
+	system->setBlynkSentFlag(true);
 }
 
 void BlynkManager::connect() {
@@ -263,30 +498,99 @@ void BlynkManager::connect() {
 		return;
 	}
 
-	if (!reconnect_timer || millis() - reconnect_timer >= SEC_TO_MLS(BLYNK_RECONNECT_TIME)) {
-		reconnect_timer = millis();
-		
-		Blynk.config(this->auth);
-		Blynk.connect(10);
+	uint32_t stage_time = millis() - connect_timer;
+
+	switch (connect_stage) {
+		case BLYNK_STAGE_IDLE: {
+			if (!reconnect.isReady()) {
+				return;
+			}
+
+			reconnect.attempt();
+			Serial.println("connect blynk");
+
+			ip_addr_t ip;
+			dns_status = BLYNK_DNS_PENDING;
+			setConnectStage(BLYNK_STAGE_DNS);
+
+			err_t result = dns_gethostbyname(BLYNK_DEFAULT_DOMAIN, &ip, dnsFound, this);
+
+			if (result == ERR_OK) {
+				server_ip = IPAddress(&ip);
+				dns_status = BLYNK_DNS_DONE;
+			}
+			else if (result != ERR_INPROGRESS) {
+				dns_status = BLYNK_DNS_FAILED;
+			}
+			break;
+		}
+
+		case BLYNK_STAGE_DNS:
+			if (dns_status == BLYNK_DNS_DONE) {
+				Blynk.config(this->auth, server_ip, BLYNK_SERVER_PORT);
+				setConnectStage(BLYNK_STAGE_TCP);
+			}
+			else if (dns_status == BLYNK_DNS_FAILED || stage_time >= SEC_TO_MLS(BLYNK_DNS_TIMEOUT)) {
+				failConnect("blynk dns failed");
+			}
+			break;
+
+		case BLYNK_STAGE_TCP:
+			// connect(0) only arms the state machine, one run() then opens the socket and sends the login.
+			// the only blocking stage: WiFiClient::connect() waits for the handshake, up to BLYNK_TCP_TIMEOUT
+			Blynk.connect(0);
+			Blynk.run();
+
+			if (_blynkTransport.connected()) {
+				setConnectStage(BLYNK_STAGE_LOGIN);
+			}
+			else {
+				failConnect("blynk tcp failed");
+			}
+			break;
 
-		Serial.println("connect blynk");
+		case BLYNK_STAGE_LOGIN:
+			if (Blynk.isTokenInvalid()) {
+				failConnect("blynk invalid auth");
+			}
+			else if (!_blynkTransport.connected() || stage_time >= SEC_TO_MLS(BLYNK_LOGIN_TIMEOUT)) {
+				failConnect("blynk login failed");
+			}
+			break;
 	}
 }
 
-extern SystemManager systemManager;
-BLYNK_WRITE_DEFAULT() {
-	BlynkManager* blynk = systemManager.getBlynkManager();
+void BlynkManager::setConnectStage(uint8_t stage) {
+	connect_stage = stage;
+	connect_timer = millis();
+}
 
-	for (uint8_t i = 0;i < blynk->getLinksCount();i++) {
-		if (blynk->getLinkPort(i) == request.pin) {
-			float data = param.asFloat();
+void BlynkManager::failConnect(const char* reason) {
+	Serial.println(reason);
 
-			blynk->notifyObservers(blynk->getLinkElementCode(i), &data, TYPE_FLOAT);
-			return;
-		}
+	Blynk.disconnect();
+	setConnectStage(BLYNK_STAGE_IDLE);
+	reconnect.fail();
+}
+
+void BlynkManager::dnsFound(const char* name, const ip_addr_t* ip, void* arg) {
+	BlynkManager* blynk = (BlynkManager*) arg;
+
+	// runs from the lwIP callback, only hand the result over to connect()
+	if (ip != NULL) {
+		blynk->server_ip = IPAddress(ip);
+		blynk->dns_status = BLYNK_DNS_DONE;
+	}
+	else {
+		blynk->dns_status = BLYNK_DNS_FAILED;
 	}
 }
 
-WiFiClient BlynkManager::_blynkWifiClient = WiFiClient();
+extern SystemManager systemManager;
+BLYNK_WRITE_DEFAULT() {
+	systemManager.getBlynkManager()->handleWrite(request.pin, param);
+}
+
+BlynkTcpClient BlynkManager::_blynkWifiClient = BlynkTcpClient();
 BlynkArduinoClient BlynkManager::_blynkTransport = BlynkArduinoClient(_blynkWifiClient);
 BlynkWifi BlynkManager::Blynk = BlynkWifi(_blynkTransport); 
\ No newline at end of file
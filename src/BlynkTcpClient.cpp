@@ -0,0 +1,25 @@
+/*
+ * Project: Temperature Tick
+ *
+ * Author: Vereshchynskyi Nazar
+ * Email: verechnazar12@gmail.com
+ * Version: 1.0.0
+ * Date: 02.03.2025
+ */
+
+#include "data.h"
+
+int BlynkTcpClient::connect(IPAddress ip, uint16_t port) {
+	// BlynkArduinoClient retries 80 on 8080 and back, a second blocking attempt is not wanted
+	if (port != BLYNK_SERVER_PORT) {
+		return 0;
+	}
+
+	// the connect still blocks until the handshake or this timeout, BlynkArduinoClient needs a WiFiClient
+	// and WiFiClient has no non-blocking connect. reads keep the library's timeout once the socket is up
+	setTimeout(BLYNK_TCP_TIMEOUT);
+	int result = WiFiClient::connect(ip, port);
+	setTimeout(BLYNK_TIMEOUT_MS);
+
+	return result;
+}
@@ -19,39 +19,84 @@ void MqttManager::makeDefault() {
 	setSystemManager(NULL);
 
 	setWorkFlag(DEFAULT_MQTT_WORK_STATUS);
+	setTlsFlag(DEFAULT_MQTT_TLS_STATUS);
+	setAsyncFlag(DEFAULT_MQTT_ASYNC_STATUS);
+	setFingerprint("");
+	setPublishMode(DEFAULT_MQTT_PUBLISH_MODE);
 	setServer("", 0);
 	setAccess("", "");
 
+	char mqtt_prefix[MQTT_PREFIX_SIZE];
+	snprintf(mqtt_prefix, MQTT_PREFIX_SIZE, DEFAULT_MQTT_PREFIX, ESP.getChipId());
+	setPrefix(mqtt_prefix);
+
+	// stable per device, the broker keeps the session under it and two boards never collide
+	snprintf(client_id, MQTT_CLIENT_ID_SIZE, DEFAULT_MQTT_CLIENT_ID, ESP.getChipId());
+
 	observers.clear();
+	memset(routes, 0, sizeof(routes));
+	routes_count = 0;
+	reconnect.setLimits(SEC_TO_MLS(MQTT_RECONNECT_MIN_TIME), SEC_TO_MLS(MQTT_RECONNECT_MAX_TIME));
+	reconnect.makeDefault();
+	queue.makeDefault();
+	memset(&stats, 0, sizeof(stats));
 	
 	reset_request = true;
-	reconnect_timer = 0;
+	send_timer = 0;
+
+	inbound_head = 0;
+	inbound_count = 0;
+	acks_head = 0;
+	acks_count = 0;
+	connect_event = false;
+	disconnect_event = false;
+	session_present = false;
+	connect_timer = 0;
+	ack_timer = 0;
+	connected_flag = false;
 }
 
 void MqttManager::begin() {
-	esp_client.setInsecure();
+	esp_client.setSession(&session);
+	mqtt_client.setBufferSize(MQTT_BUFFER_SIZE);
 
 	mqtt_client.setCallback([this](char* topic, byte* payload, unsigned int length) {
 		// Serial.print("Topic: ");
 		// Serial.print(topic); Serial.print(" "); Serial.println(length);
 	
-		char* buffer = new char[length + 1];
+		// handled after loop() returns, the QoS1 PUBACK goes out first so a command that resets is not redelivered
+		pushInbound(topicToRoute(topic), (const char*) payload, length);
+	});
 
-		memcpy(buffer, payload, length);
-		buffer[length] = 0;
-	
-		// Serial.print("Payload: ");
-		// Serial.println(buffer);
+	// async callbacks run outside loop(), they only record what happened and tick() does the work
+	async_client.onConnect([this](bool session_present) {
+		this->session_present = session_present;
+		connect_event = true;
+	});
+
+	async_client.onDisconnect([this](AsyncMqttClientDisconnectReason reason) {
+		disconnect_event = true;
+	});
+
+	async_client.onPublish([this](uint16_t packet_id) {
+		if (acks_count >= MQTT_INFLIGHT_MAX) {
+			return;
+		}
 
-		float data = atoff(buffer);
-		notifyObservers(topic, &data, TYPE_FLOAT);
+		acks[(acks_head + acks_count) % MQTT_INFLIGHT_MAX] = packet_id;
+		acks_count++;
+	});
 
-		// Serial.print("number: ");
-		// Serial.println(data);
+	async_client.onMessage([this](char* topic, char* payload, AsyncMqttClientMessageProperties properties, size_t length, size_t index, size_t total) {
+		if (index || length != total) {
+			return;
+		}
 
-		delete[] buffer;
+		pushInbound(topicToRoute(topic), payload, length);
 	});
 
+	readSession();
+	queue.begin();
 	tick();
 }
 
@@ -65,15 +110,33 @@ void MqttManager::tick() {
 		off();
 	}
 
+	if (connected_flag && getStatus()) {
+		stats.disconnects++;
+	}
+	connected_flag = !getStatus();
+
+	// readings keep arriving without a connection, that is exactly when they pile up for flash
+	queue.tick();
+
 	if (!getWorkFlag() || !*getServer() || network->getStatus() != WL_CONNECTED) {
 		return;
 	}
 
+	if (getAsyncFlag()) {
+		asyncTick();
+		return;
+	}
+
 	if (getStatus()) {
 		connect();
 	}
 
 	mqtt_client.loop();
+	handleInbound();
+
+	if (!getStatus()) {
+		sendQueue();
+	}
 }
 
 void MqttManager::addElementCodes(DynamicArray<String>* array) {
@@ -90,19 +153,58 @@ void MqttManager::addObserver(IObserver* observer) {
 }
 
 bool MqttManager::handleEvent(const char* code, void* data, uint8_t type) {
-	if (getWorkFlag()) {
-		if (mqtt_client.publish(code, String(POINTER_TO_TYPE(data, type)).c_str()) ) {
-			system->setMqttSentFlag(true);
-			return true;
+	if (!strcmp(code, "/network/data/connected")) {
+		if (*(bool*) data) {
+			reconnect.retryNow();
+		}
+
+		return false;
+	}
+
+	if (!getWorkFlag() || !*getServer()) {
+		return false;
+	}
+
+	char topic[MQTT_TOPIC_SIZE];
+	if (!makeTopic(topic, code)) {
+		return false;
+	}
+
+	// diagnostics are only meaningful live, they are not queued
+	if (type == TYPE_STRING) {
+		return !getStatus() && publish(topic, (const char*) data);
+	}
+
+	// in batch mode single readings are collected from the managers once the read cycle ends
+	if (!strcmp(code, "/sensors/data/updated")) {
+		if (getPublishMode() == MQTT_PUBLISH_BATCH) {
+			pushBatch();
 		}
+
+		return false;
+	}
+
+	// only readings wait for the batch, relay and other state changes go out at once
+	if (getPublishMode() == MQTT_PUBLISH_BATCH && !strncmp(code, "/sensors/data/", 14)) {
+		return false;
 	}
 
-	return false;
+	char payload[FORMAT_BUFFER_SIZE];
+	if (!formatValue(payload, FORMAT_BUFFER_SIZE, data, type, MQTT_VALUE_DECIMALS)) {
+		return false;
+	}
+
+	return queue.push(topic, payload);
 }
 
 
 void MqttManager::writeSettings(char* buffer) {
 	setParameter(buffer, "MSwf", getWorkFlag());
+	setParameter(buffer, "MSaf", getAsyncFlag());
+	setParameter(buffer, "MStf", getTlsFlag());
+	setParameter(buffer, "MSf", (const char*) getFingerprint());
+	setParameter(buffer, "MSpm", getPublishMode());
+	setParameter(buffer, "MSp", (const char*) getPrefix());
 	
 	setParameter(buffer, "MSSs", (const char*) getServer());
 	setParameter(buffer, "MSSp", getPort());
@@ -112,6 +214,11 @@ void MqttManager::writeSettings(char* buffer) {
 
 void MqttManager::readSettings(char* buffer) {
 	getParameter(buffer, "MSwf", &work_flag);
+	getParameter(buffer, "MSaf", &async_flag);
+	getParameter(buffer, "MStf", &tls_flag);
+	getParameter(buffer, "MSf", mqtt_fingerprint, MQTT_FINGERPRINT_SIZE);
+	getParameter(buffer, "MSpm", &publish_mode);
+	getParameter(buffer, "MSp", mqtt_prefix, MQTT_PREFIX_SIZE);
 
 	getParameter(buffer, "MSSs", mqtt_server, MQTT_SERVER_SIZE);
 	getParameter(buffer, "MSSp", &mqtt_port);
@@ -119,11 +226,73 @@ void MqttManager::readSettings(char* buffer) {
 	getParameter(buffer, "MSAp", mqtt_pass, MQTT_SSID_PASS_SIZE);
 
 	setWorkFlag(work_flag);
+	setTlsFlag(tls_flag);
+	setAsyncFlag(async_flag);
+	setFingerprint(mqtt_fingerprint);
+	setPublishMode(publish_mode);
+	setPrefix(mqtt_prefix);
 	setServer(mqtt_server, mqtt_port);
 	setAccess(mqtt_ssid, mqtt_pass);
 }
 
 
+bool MqttManager::addRoute(const char* code, IObserver* observer, uint8_t type) {
+	if (code == NULL || observer == NULL || strlen(code) >= MQTT_ROUTE_CODE_SIZE || routes_count >= MQTT_ROUTES_MAX) {
+		return false;
+	}
+
+	uint32_t hash = calcHash(code);
+	uint8_t index = hash & (MQTT_ROUTES_TABLE_SIZE - 1);
+
+	// linear probing, the table is never more than half full
+	while (routes[index].observer != NULL) {
+		if (routes[index].hash == hash && !strcmp(routes[index].code, code)) {
+			routes[index].observer = observer;
+			routes[index].type = type;
+			return true;
+		}
+
+		index = (index + 1) & (MQTT_ROUTES_TABLE_SIZE - 1);
+	}
+
+	routes[index].hash = hash;
+	strcpy(routes[index].code, code);
+	routes[index].observer = observer;
+	routes[index].type = type;
+	routes_count++;
+
+	reset_request = true;
+	return true;
+}
+
+void MqttManager::saveQueue() {
+	queue.save();
+}
+
+void MqttManager::forceDisconnect() {
+	Serial.println("mqtt force disconnect");
+
+	// the transport drops without touching the policy, the next tick reconnects as after a real outage
+	if (getAsyncFlag()) {
+		async_client.disconnect(true);
+	}
+	else {
+		mqtt_client.disconnect();
+	}
+}
+
+uint16_t MqttManager::printStats(char* buffer, uint16_t size) {
+	if (buffer == NULL || !size) {
+		return 0;
+	}
+
+	int length = snprintf(buffer, size, "{\"t\":%u,\"in\":%u,\"sent\":%u,\"acked\":%u,\"drop\":%u,\"queue\":%u,\"disc\":%u}",
+		millis() / 1000, queue.getPushed(), stats.sent, stats.acked, queue.getDropped(), queue.getCount(), stats.disconnects);
+
+	return (length < size) ? length : size - 1;
+}
+
+
 void MqttManager::setSystemManager(SystemManager* system) {
 	this->system = system;
 }
@@ -137,6 +306,63 @@ void MqttManager::setWorkFlag(bool work_flag) {
 	}
 }
 
+void MqttManager::setAsyncFlag(bool async_flag) {
+	// the async client has no TLS, with TLS on it would send the credentials in plaintext
+	this->async_flag = async_flag && !getTlsFlag();
+	reset_request = true;
+}
+
+void MqttManager::setTlsFlag(bool tls_flag) {
+	this->tls_flag = tls_flag;
+
+	if (getTlsFlag()) {
+		async_flag = false;
+	}
+	reset_request = true;
+}
+
+void MqttManager::setFingerprint(String* mqtt_fingerprint) {
+	setFingerprint((mqtt_fingerprint != NULL) ? mqtt_fingerprint->c_str() : NULL);
+}
+void MqttManager::setFingerprint(const char* mqtt_fingerprint) {
+	if (mqtt_fingerprint == NULL) {
+		return;
+	}
+
+	strlcpy(this->mqtt_fingerprint, mqtt_fingerprint, MQTT_FINGERPRINT_SIZE);
+
+	// a pinned server is checked on the next full handshake, resumed sessions inherit that check
+	if (!*getFingerprint() || !esp_client.setFingerprint(getFingerprint())) {
+		esp_client.setInsecure();
+	}
+
+	session = BearSSL::Session();
+	reset_request = true;
+}
+
+void MqttManager::setPublishMode(uint8_t publish_mode) {
+	this->publish_mode = constrain(publish_mode, MQTT_PUBLISH_SINGLE, MQTT_PUBLISH_BATCH);
+}
+
+void MqttManager::setPrefix(String* mqtt_prefix) {
+	setPrefix((mqtt_prefix != NULL) ? mqtt_prefix->c_str() : NULL);
+}
+void MqttManager::setPrefix(const char* mqtt_prefix) {
+	if (mqtt_prefix == NULL || strpbrk(mqtt_prefix, "#+") != NULL) {
+		return;
+	}
+
+	strlcpy(this->mqtt_prefix, mqtt_prefix, MQTT_PREFIX_SIZE);
+
+	// codes already start with '/'
+	uint8_t length = strlen(this->mqtt_prefix);
+	while (length && this->mqtt_prefix[length - 1] == '/') {
+		this->mqtt_prefix[--length] = 0;
+	}
+
+	reset_request = true;
+}
+
 void MqttManager::setServer(String* mqtt_server, uint16_t mqtt_port) {
 	setServer((mqtt_server != NULL) ? mqtt_server->c_str() : NULL, mqtt_port);
 }
@@ -146,6 +372,7 @@ void MqttManager::setServer(const char* mqtt_server, uint16_t mqtt_port) {
 	}
 	
 	this->mqtt_port = mqtt_port;
+	session = BearSSL::Session();
 	reset_request = true;
 
 	mqtt_client.setServer(mqtt_server, mqtt_port);
@@ -167,13 +394,53 @@ void MqttManager::setAccess(const char* mqtt_ssid, const char* mqtt_pass) {
 
 
 int8_t MqttManager::getStatus() {
+	if (getAsyncFlag()) {
+		return (async_client.connected()) ? MQTT_CONNECTED : MQTT_DISCONNECTED;
+	}
+
 	return mqtt_client.state();
 }
 
+ReconnectPolicy* MqttManager::getReconnectPolicy() {
+	return &reconnect;
+}
+
+MqttQueue* MqttManager::getQueue() {
+	return &queue;
+}
+
+mqtt_stats_t* MqttManager::getStats() {
+	return &stats;
+}
+
 bool MqttManager::getWorkFlag() {
 	return work_flag;
 }
 
+bool MqttManager::getAsyncFlag() {
+	return async_flag;
+}
+
+bool MqttManager::getTlsFlag() {
+	return tls_flag;
+}
+
+char* MqttManager::getFingerprint() {
+	return mqtt_fingerprint;
+}
+
+uint8_t MqttManager::getPublishMode() {
+	return publish_mode;
+}
+
+char* MqttManager::getPrefix() {
+	return mqtt_prefix;
+}
+
+char* MqttManager::getClientId() {
+	return client_id;
+}
+
 
 char* MqttManager::getServer() {
 	return mqtt_server;
@@ -203,17 +470,402 @@ void MqttManager::notifyObservers(String code, void* data, uint8_t type) {
 
 void MqttManager::off() {
 	mqtt_client.disconnect();
-	reconnect_timer = 0;
+	async_client.disconnect(true);
+
+	connect_timer = 0;
+	queue.markResend();
+	reconnect.reset();
 }
 
 void MqttManager::connect() {
-	if (!reconnect_timer || millis() - reconnect_timer >= SEC_TO_MLS(MQTT_RECONNECT_TIME)) {
-		reconnect_timer = millis();
-		
-		mqtt_client.setServer(mqtt_server, mqtt_port);
-		if (mqtt_client.connect("ESP8266Client", getSsid(), getPass()) ) {
-			mqtt_client.subscribe("/#");
+	if (!reconnect.isReady()) {
+		return;
+	}
+
+	Serial.println("connect mqtt");
+	reconnect.attempt();
+	
+	if (getTlsFlag()) {
+		mqtt_client.setClient(esp_client);
+	}
+	else {
+		mqtt_client.setClient(tcp_client);
+	}
+
+	mqtt_client.setServer(mqtt_server, mqtt_port);
+	if (mqtt_client.connect(getClientId(), getSsid(), getPass(), NULL, 0, false, NULL, false) ) {
+		char topic[MQTT_TOPIC_SIZE];
+
+		// only the command topics of this device, never the whole broker
+		for (uint8_t i = 0;i < MQTT_ROUTES_TABLE_SIZE;i++) {
+			if (routes[i].observer != NULL && makeTopic(topic, routes[i].code)) {
+				mqtt_client.subscribe(topic, 1);
+			}
+		}
+
+		if (getTlsFlag()) {
+			writeSession();
+		}
+
+		reconnect.success();
+	}
+	else {
+		reconnect.fail();
+	}
+}
+
+void MqttManager::sendQueue() {
+	if (millis() - send_timer < MQTT_QUEUE_SEND_INTERVAL) {
+		return;
+	}
+	send_timer = millis();
+
+	// a few messages per window, loop() runs between windows so keepalive and inbound traffic keep flowing
+	for (uint8_t i = 0;i < MQTT_QUEUE_SEND_COUNT;i++) {
+		mqtt_message_t* message = queue.front();
+
+		if (message == NULL) {
+			break;
+		}
+
+		// left over from the async transport
+		if (message->state == MQTT_MESSAGE_DONE) {
+			queue.pop();
+			continue;
+		}
+
+		if (queue.isExpired(message)) {
+			queue.drop();
+			continue;
+		}
+
+		if (!mqtt_client.publish(message->topic, message->payload)) {
+			if (++message->retries >= MQTT_QUEUE_MAX_RETRIES) {
+				queue.drop();
+			}
+
+			break;
+		}
+
+		// QoS0 has no acknowledgement, a socket write is only counted as sent
+		stats.sent++;
+		queue.pop();
+
+		if (!queue.getCount()) {
+			system->setMqttSentFlag(true);
+		}
+	}
+}
+
+bool MqttManager::publish(const char* topic, const char* payload) {
+	if (getAsyncFlag()) {
+		return async_client.publish(topic, 0, false, payload);
+	}
+
+	return mqtt_client.publish(topic, payload);
+}
+
+void MqttManager::pushBatch() {
+	SensorsManager* sensors = system->getSensorsManager();
+	RelayManager* relay = system->getRelayManager();
+
+	char payload[MQTT_PAYLOAD_SIZE];
+	uint16_t length = snprintf(payload, MQTT_PAYLOAD_SIZE, "{");
+
+	for (uint8_t i = 0;i < sensors->getDS18B20Count() && length < MQTT_PAYLOAD_SIZE;i++) {
+		length += snprintf(payload + length, MQTT_PAYLOAD_SIZE - length, "\"%s\":", sensors->getDS18B20Name(i));
+
+		if (length < MQTT_PAYLOAD_SIZE && !sensors->getDS18B20Status(i)) {
+			uint8_t value_length = formatFloat(payload + length, MQTT_PAYLOAD_SIZE - length, sensors->getDS18B20T(i), MQTT_VALUE_DECIMALS);
+			length = (value_length) ? length + value_length : MQTT_PAYLOAD_SIZE;
+		}
+		else if (length < MQTT_PAYLOAD_SIZE) {
+			length += snprintf(payload + length, MQTT_PAYLOAD_SIZE - length, "null");
+		}
+
+		if (length < MQTT_PAYLOAD_SIZE) {
+			length += snprintf(payload + length, MQTT_PAYLOAD_SIZE - length, ",");
+		}
+	}
+
+	if (length < MQTT_PAYLOAD_SIZE) {
+		length += snprintf(payload + length, MQTT_PAYLOAD_SIZE - length, "\"relay\":[");
+	}
+
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT && length < MQTT_PAYLOAD_SIZE;i++) {
+		length += snprintf(payload + length, MQTT_PAYLOAD_SIZE - length, (i) ? ",%u" : "%u", relay->getRelayFlag(i));
+	}
+
+	if (length < MQTT_PAYLOAD_SIZE) {
+		length += snprintf(payload + length, MQTT_PAYLOAD_SIZE - length, "]}");
+	}
+
+	if (length >= MQTT_PAYLOAD_SIZE) {
+		Serial.println("mqtt batch overflow");
+		return;
+	}
+
+	char topic[MQTT_TOPIC_SIZE];
+
+	if (makeTopic(topic, MQTT_BATCH_TOPIC)) {
+		queue.push(topic, payload);
+	}
+}
+
+void MqttManager::completeMessage(mqtt_message_t* message) {
+	stats.acked++;
+
+#if PROFILER_ENABLED
+	uint32_t latency = millis() - message->time;
+	system->getProfiler()->addSample(PROFILER_MQTT_LATENCY, latency);
+#endif
+}
+
+bool MqttManager::makeTopic(char* buffer, const char* code) {
+	return snprintf(buffer, MQTT_TOPIC_SIZE, "%s%s", getPrefix(), code) < MQTT_TOPIC_SIZE;
+}
+
+
+void MqttManager::asyncTick() {
+	handleInbound();
+	// before the disconnect below, an acknowledged message must not be marked for resend
+	handleAcks();
+
+	if (disconnect_event) {
+		disconnect_event = false;
+		queue.markResend();
+
+		if (connect_timer) {
+			connect_timer = 0;
+			reconnect.fail();
+		}
+	}
+
+	if (connect_event) {
+		connect_event = false;
+
+		if (async_client.connected()) {
+			char topic[MQTT_TOPIC_SIZE];
+
+			// without a stored session the broker forgot the old packet ids
+			if (!session_present) {
+				queue.clearResend();
+			}
+
+			for (uint8_t i = 0;i < MQTT_ROUTES_TABLE_SIZE;i++) {
+				if (routes[i].observer != NULL && makeTopic(topic, routes[i].code)) {
+					async_client.subscribe(topic, 1);
+				}
+			}
+
+			connect_timer = 0;
+			ack_timer = millis();
+			reconnect.success();
+		}
+	}
+
+	if (!async_client.connected()) {
+		asyncConnect();
+		return;
+	}
+
+	asyncSendQueue();
+}
+
+void MqttManager::asyncConnect() {
+	if (connect_timer) {
+		if (millis() - connect_timer < SEC_TO_MLS(MQTT_CONNECT_TIMEOUT)) {
+			return;
+		}
+
+		connect_timer = 0;
+		async_client.disconnect(true);
+		reconnect.fail();
+	}
+
+	if (!reconnect.isReady()) {
+		return;
+	}
+
+	Serial.println("connect mqtt async");
+	reconnect.attempt();
+	connect_timer = millis();
+
+	// the client keeps the pointers, the buffers are members
+	async_client.setServer(mqtt_server, mqtt_port);
+	async_client.setClientId(getClientId());
+	async_client.setCleanSession(false);
+	async_client.setCredentials((*getSsid()) ? getSsid() : NULL, (*getPass()) ? getPass() : NULL);
+	async_client.connect();
+}
+
+void MqttManager::asyncSendQueue() {
+	mqtt_message_t* message;
+	uint8_t inflight = 0;
+
+	// acknowledged messages leave the queue in order
+	while ((message = queue.front()) != NULL && message->state == MQTT_MESSAGE_DONE) {
+		queue.pop();
+
+		if (!queue.getCount()) {
+			system->setMqttSentFlag(true);
 		}
-		Serial.println("connect mqtt");
 	}
-}
\ No newline at end of file
+
+	if (message != NULL && message->state == MQTT_MESSAGE_QUEUED && queue.isExpired(message)) {
+		queue.drop();
+		return;
+	}
+
+	for (uint8_t i = 0;(message = queue.peek(i)) != NULL && inflight < MQTT_INFLIGHT_MAX;i++) {
+		if (message->state == MQTT_MESSAGE_SENT) {
+			inflight++;
+			continue;
+		}
+		if (message->state == MQTT_MESSAGE_DONE) {
+			continue;
+		}
+
+		// returns at once, the PUBACK arrives in onPublish
+		bool dup = (message->state == MQTT_MESSAGE_RESEND);
+		uint16_t packet_id = async_client.publish(message->topic, 1, false, message->payload, 0, dup, (dup) ? message->packet_id : 0);
+		if (!packet_id) {
+			break;
+		}
+
+		if (!inflight) {
+			ack_timer = millis();
+		}
+
+		message->packet_id = packet_id;
+		message->state = MQTT_MESSAGE_SENT;
+		stats.sent++;
+		inflight++;
+	}
+
+	// a silent broker is treated as a dead connection, the window is resent after reconnect
+	if (inflight && millis() - ack_timer > SEC_TO_MLS(MQTT_ACK_TIMEOUT)) {
+		Serial.println("mqtt ack timeout");
+		async_client.disconnect(true);
+	}
+}
+
+void MqttManager::pushInbound(mqtt_route_t* route, const char* payload, uint16_t length) {
+	if (route == NULL || length >= MQTT_INBOUND_PAYLOAD_SIZE || inbound_count >= MQTT_INBOUND_MAX) {
+		return;
+	}
+
+	mqtt_inbound_t* message = &inbound[(inbound_head + inbound_count) % MQTT_INBOUND_MAX];
+
+	// payload is not null terminated, it is parsed by length
+	message->route = route;
+	message->length = length;
+	memcpy(message->payload, payload, length);
+
+	inbound_count++;
+}
+
+void MqttManager::handleInbound() {
+	while (inbound_count) {
+		mqtt_inbound_t* message = &inbound[inbound_head];
+		handleRoute(message->route, message->payload, message->length);
+
+		inbound_head = (inbound_head + 1) % MQTT_INBOUND_MAX;
+		inbound_count--;
+	}
+}
+
+void MqttManager::handleAcks() {
+	while (acks_count) {
+		mqtt_message_t* message = queue.ack(acks[acks_head]);
+
+		if (message != NULL) {
+			completeMessage(message);
+		}
+
+		ack_timer = millis();
+
+		acks_head = (acks_head + 1) % MQTT_INFLIGHT_MAX;
+		acks_count--;
+	}
+}
+
+
+mqtt_route_t* MqttManager::topicToRoute(const char* topic) {
+	uint8_t prefix_length = strlen(getPrefix());
+
+	if (strncmp(topic, getPrefix(), prefix_length)) {
+		return NULL;
+	}
+
+	return findRoute(topic + prefix_length);
+}
+
+mqtt_route_t* MqttManager::findRoute(const char* code) {
+	uint32_t hash = calcHash(code);
+	uint8_t index = hash & (MQTT_ROUTES_TABLE_SIZE - 1);
+
+	while (routes[index].observer != NULL) {
+		if (routes[index].hash == hash && !strcmp(routes[index].code, code)) {
+			return &routes[index];
+		}
+
+		index = (index + 1) & (MQTT_ROUTES_TABLE_SIZE - 1);
+	}
+
+	return NULL;
+}
+
+void MqttManager::handleRoute(mqtt_route_t* route, const char* payload, uint16_t length) {
+	if (route->type == TYPE_BOOL) {
+		bool data;
+
+		if (parseBool(payload, length, &data)) {
+			route->observer->handleEvent(route->code, &data, TYPE_BOOL);
+		}
+	}
+	else if (route->type == TYPE_FLOAT) {
+		int32_t fixed;
+
+		if (parseFixed(payload, length, &fixed, MQTT_FIXED_DECIMALS)) {
+			float data = (float) fixed / MQTT_FIXED_SCALE;
+			route->observer->handleEvent(route->code, &data, TYPE_FLOAT);
+		}
+	}
+	else {
+		int32_t data;
+
+		if (parseInt(payload, length, &data)) {
+			route->observer->handleEvent(route->code, &data, TYPE_INT32_T);
+		}
+	}
+}
+
+uint32_t MqttManager::getServerHash() {
+	uint32_t hash = calcCrc32(getServer(), strlen(getServer()));
+	return hash ^ calcCrc32(&mqtt_port, sizeof(mqtt_port)) ^ calcCrc32(getFingerprint(), strlen(getFingerprint()));
+}
+
+void MqttManager::readSession() {
+	mqtt_session_cache_t cache;
+	ESP.rtcUserMemoryRead(RTC_MQTT_SESSION_BLOCK, (uint32_t*) &cache, sizeof(cache));
+
+	if (cache.crc != calcCrc32((uint8_t*) &cache + sizeof(cache.crc), sizeof(cache) - sizeof(cache.crc))) {
+		return;
+	}
+
+	// the session only resumes against the server (and pin) it was negotiated with
+	if (cache.server_hash == getServerHash()) {
+		session = cache.session;
+	}
+}
+
+void MqttManager::writeSession() {
+	mqtt_session_cache_t cache;
+
+	cache.server_hash = getServerHash();
+	cache.session = session;
+	cache.crc = calcCrc32((uint8_t*) &cache + sizeof(cache.crc), sizeof(cache) - sizeof(cache.crc));
+
+	ESP.rtcUserMemoryWrite(RTC_MQTT_SESSION_BLOCK, (uint32_t*) &cache, sizeof(cache));
+}
@@ -0,0 +1,382 @@
+/*
+ * Project: Temperature Tick
+ *
+ * Author: Vereshchynskyi Nazar
+ * Email: verechnazar12@gmail.com
+ * Version: 1.0.0
+ * Date: 02.03.2025
+ */
+
+#include "data.h"
+
+MqttQueue::MqttQueue() {
+	makeDefault();
+}
+
+
+void MqttQueue::makeDefault() {
+	head = 0;
+	count = 0;
+	boot = ESP.random();
+
+	staging_count = 0;
+	flush_timer = 0;
+
+	spill_count = 0;
+	spill_offset = 0;
+	pushed = 0;
+	dropped = 0;
+}
+
+void MqttQueue::begin() {
+	File file = LittleFS.open(MQTT_QUEUE_SPILL_PATH, "r");
+
+	if (file) {
+		spill_count = file.size() / sizeof(mqtt_message_t);
+		spill_offset = 0;
+
+		// written by a firmware with another record layout, it can't be read back
+		if (file.size() % sizeof(mqtt_message_t)) {
+			spill_count = 0;
+		}
+
+		file.close();
+	}
+
+	if (!spill_count) {
+		LittleFS.remove(MQTT_QUEUE_SPILL_PATH);
+	}
+}
+
+void MqttQueue::tick() {
+	if (staging_count && (staging_count >= MQTT_QUEUE_STAGING_SIZE || millis() - flush_timer >= MQTT_QUEUE_FLUSH_INTERVAL)) {
+		flush();
+	}
+}
+
+
+bool MqttQueue::push(const char* topic, const char* payload) {
+	if (topic == NULL || payload == NULL) {
+		return false;
+	}
+
+	mqtt_message_t message;
+
+	strlcpy(message.topic, topic, MQTT_TOPIC_SIZE);
+	strlcpy(message.payload, payload, MQTT_PAYLOAD_SIZE);
+	message.time = millis();
+	message.epoch = SystemManager::getClockTime();
+	message.boot = boot;
+	message.packet_id = 0;
+	message.state = MQTT_MESSAGE_QUEUED;
+	message.retries = 0;
+
+	// once something waits for flash, new messages go behind it to keep the order
+	if (spill_count || staging_count || count >= MQTT_QUEUE_SIZE) {
+		// tick() fell behind, write the batch now
+		if (staging_count >= MQTT_QUEUE_STAGING_SIZE) {
+			flush();
+		}
+
+		// flash refused it, the oldest staged message makes room
+		if (staging_count >= MQTT_QUEUE_STAGING_SIZE) {
+			memmove(&staging[0], &staging[1], (MQTT_QUEUE_STAGING_SIZE - 1) * sizeof(mqtt_message_t));
+			staging_count--;
+			dropped++;
+		}
+
+		if (!staging_count) {
+			flush_timer = millis();
+		}
+		staging[staging_count++] = message;
+	}
+	else {
+		ring[(head + count) % MQTT_QUEUE_SIZE] = message;
+		count++;
+	}
+
+	pushed++;
+	return true;
+}
+
+mqtt_message_t* MqttQueue::front() {
+	return peek(0);
+}
+
+mqtt_message_t* MqttQueue::peek(uint8_t index) {
+	refill();
+
+	return (index < count) ? &ring[(head + index) % MQTT_QUEUE_SIZE] : NULL;
+}
+
+void MqttQueue::pop() {
+	if (!count) {
+		return;
+	}
+
+	head = (head + 1) % MQTT_QUEUE_SIZE;
+	count--;
+}
+
+void MqttQueue::drop() {
+	if (!count) {
+		return;
+	}
+
+	pop();
+	dropped++;
+}
+
+mqtt_message_t* MqttQueue::ack(uint16_t packet_id) {
+	for (uint8_t i = 0;i < count;i++) {
+		mqtt_message_t* message = &ring[(head + i) % MQTT_QUEUE_SIZE];
+
+		if (message->state == MQTT_MESSAGE_SENT && message->packet_id == packet_id) {
+			message->state = MQTT_MESSAGE_DONE;
+			return message;
+		}
+	}
+
+	return NULL;
+}
+
+void MqttQueue::markResend() {
+	for (uint8_t i = 0;i < count;i++) {
+		mqtt_message_t* message = &ring[(head + i) % MQTT_QUEUE_SIZE];
+
+		if (message->state != MQTT_MESSAGE_SENT) {
+			continue;
+		}
+
+		if (++message->retries >= MQTT_QUEUE_MAX_RETRIES) {
+			message->state = MQTT_MESSAGE_DONE;
+			dropped++;
+		}
+		else {
+			message->state = MQTT_MESSAGE_RESEND;
+		}
+	}
+}
+
+void MqttQueue::clearResend() {
+	for (uint8_t i = 0;i < count;i++) {
+		mqtt_message_t* message = &ring[(head + i) % MQTT_QUEUE_SIZE];
+
+		if (message->state == MQTT_MESSAGE_RESEND) {
+			message->state = MQTT_MESSAGE_QUEUED;
+			message->packet_id = 0;
+		}
+	}
+}
+
+bool MqttQueue::isExpired(mqtt_message_t* message) {
+	stampEpoch(message);
+
+	if (message->epoch) {
+		time_t now = SystemManager::getClockTime();
+		return now && now - message->epoch > (uint32_t) MQTT_QUEUE_MAX_AGE * 3600;
+	}
+
+	// no clock yet, only an age from this boot can be measured
+	return message->boot == boot && millis() - message->time > (uint32_t) MQTT_QUEUE_MAX_AGE * 3600000UL;
+}
+
+void MqttQueue::save() {
+	// with RAM empty the file still has to lose what was already sent, begin() reads it from the start
+	if (!count && !staging_count && !spill_offset) {
+		return;
+	}
+
+	rewrite(true);
+}
+
+
+uint16_t MqttQueue::getCount() {
+	return count + staging_count + spill_count;
+}
+
+uint8_t MqttQueue::getRamCount() {
+	return count;
+}
+
+uint16_t MqttQueue::getSpillCount() {
+	return spill_count;
+}
+
+uint32_t MqttQueue::getPushed() {
+	return pushed;
+}
+
+uint32_t MqttQueue::getDropped() {
+	return dropped;
+}
+
+
+void MqttQueue::flush() {
+	// with nothing on flash the staged messages may fit in RAM and never get written
+	refill();
+
+	if (!staging_count) {
+		return;
+	}
+	flush_timer = millis();
+
+	// a full file loses its oldest messages, they are the closest to expiring and the newest readings are worth more
+	if (spill_count + staging_count > MQTT_QUEUE_SPILL_MAX_COUNT) {
+		uint16_t excess = min((uint16_t) (spill_count + staging_count - MQTT_QUEUE_SPILL_MAX_COUNT), spill_count);
+
+		spill_offset += (uint32_t) excess * sizeof(mqtt_message_t);
+		spill_count -= excess;
+		dropped += excess;
+	}
+
+	// sent and dropped messages still take flash in front of spill_offset, past a quarter of the file it is written anew without them
+	if (spill_offset >= (uint32_t) MQTT_QUEUE_SPILL_MAX_COUNT / 4 * sizeof(mqtt_message_t) && rewrite(false)) {
+		return;
+	}
+
+	File file = LittleFS.open(MQTT_QUEUE_SPILL_PATH, "a");
+	if (!file) {
+		return;
+	}
+
+	// one write for the whole batch, what did not fit stays staged for the next try
+	uint32_t size = file.size();
+	uint32_t length = file.write((uint8_t*) staging, staging_count * sizeof(mqtt_message_t));
+	uint8_t written = length / sizeof(mqtt_message_t);
+
+	// a cut record would shift every record after it
+	if (length % sizeof(mqtt_message_t)) {
+		file.truncate(size + written * sizeof(mqtt_message_t));
+	}
+	file.close();
+
+	memmove(&staging[0], &staging[written], (staging_count - written) * sizeof(mqtt_message_t));
+	staging_count -= written;
+	spill_count += written;
+}
+
+bool MqttQueue::rewrite(bool ram_flag) {
+	File file = LittleFS.open(MQTT_QUEUE_SPILL_TMP_PATH, "w");
+	bool result = file;
+
+	if (!result) {
+		return false;
+	}
+
+	// RAM messages are older than the spilled ones, the staged ones are the newest
+	for (uint8_t i = 0;ram_flag && i < count;i++) {
+		mqtt_message_t* message = &ring[(head + i) % MQTT_QUEUE_SIZE];
+
+		if (message->state != MQTT_MESSAGE_DONE) {
+			result &= file.write((uint8_t*) message, sizeof(mqtt_message_t)) == sizeof(mqtt_message_t);
+		}
+	}
+
+	if (spill_count) {
+		File spill_file = LittleFS.open(MQTT_QUEUE_SPILL_PATH, "r");
+
+		if (spill_file) {
+			mqtt_message_t message;
+			spill_file.seek(spill_offset);
+
+			for (uint16_t i = 0;result && i < spill_count && spill_file.read((uint8_t*) &message, sizeof(mqtt_message_t)) == sizeof(mqtt_message_t);i++) {
+				result &= file.write((uint8_t*) &message, sizeof(mqtt_message_t)) == sizeof(mqtt_message_t);
+			}
+
+			spill_file.close();
+		}
+	}
+
+	result &= file.write((uint8_t*) staging, staging_count * sizeof(mqtt_message_t)) == staging_count * sizeof(mqtt_message_t);
+
+	uint16_t size = file.size() / sizeof(mqtt_message_t);
+	file.close();
+
+	// the old file needs room next to the new one, without it the old one stays as it was
+	if (!result) {
+		LittleFS.remove(MQTT_QUEUE_SPILL_TMP_PATH);
+		return false;
+	}
+
+	spill_count = size;
+	LittleFS.remove(MQTT_QUEUE_SPILL_PATH);
+	LittleFS.rename(MQTT_QUEUE_SPILL_TMP_PATH, MQTT_QUEUE_SPILL_PATH);
+
+	spill_offset = 0;
+	staging_count = 0;
+
+	if (ram_flag) {
+		head = 0;
+		count = 0;
+	}
+
+	return true;
+}
+
+void MqttQueue::stampEpoch(mqtt_message_t* message) {
+	time_t now = SystemManager::getClockTime();
+
+	if (message->epoch || !now) {
+		return;
+	}
+
+	// queued before the clock synced, back-dated while the millis() stamp is still valid
+	message->epoch = (message->boot == boot) ? now - (millis() - message->time) / 1000 : now;
+}
+
+void MqttQueue::refill() {
+	if (spill_count && !count) {
+		File file = LittleFS.open(MQTT_QUEUE_SPILL_PATH, "r");
+
+		if (file) {
+			file.seek(spill_offset);
+
+			while (spill_count && count < MQTT_QUEUE_SIZE) {
+				mqtt_message_t* message = &ring[(head + count) % MQTT_QUEUE_SIZE];
+
+				if (file.read((uint8_t*) message, sizeof(mqtt_message_t)) != sizeof(mqtt_message_t)) {
+					spill_count = 0;
+					break;
+				}
+
+				// a millis() stamp from before a reboot or deep sleep is meaningless, the clock time carries the age instead
+				if (message->boot != boot) {
+					stampEpoch(message);
+
+					message->time = millis();
+					message->boot = boot;
+				}
+
+				// packet ids restart after a reboot and may already be taken, whatever was in flight goes again as a new publish
+				if (message->state == MQTT_MESSAGE_SENT || message->state == MQTT_MESSAGE_RESEND) {
+					message->state = MQTT_MESSAGE_QUEUED;
+					message->packet_id = 0;
+				}
+
+				spill_offset += sizeof(mqtt_message_t);
+				spill_count--;
+				count++;
+			}
+
+			file.close();
+		}
+		else {
+			spill_count = 0;
+		}
+
+		if (!spill_count) {
+			LittleFS.remove(MQTT_QUEUE_SPILL_PATH);
+			spill_offset = 0;
+		}
+	}
+
+	// with nothing left on flash the staged messages are next in line, they move over without touching it
+	while (!spill_count && staging_count && count < MQTT_QUEUE_SIZE) {
+		ring[(head + count) % MQTT_QUEUE_SIZE] = staging[0];
+		memmove(&staging[0], &staging[1], (staging_count - 1) * sizeof(mqtt_message_t));
+
+		staging_count--;
+		count++;
+	}
+}
@@ -18,23 +18,69 @@ void NetworkManager::makeDefault() {
 	setSystemManager(NULL);
 	
 	setMode(DEFAULT_NETWORK_MODE);
-	setWifi("", "");
 	setAp("", "");
+
+	wifi_list.clear();
+	wifi_list.setMaxSize(NETWORK_WIFI_MAX_COUNT);
+
+	observers.clear();
+	reconnect.setLimits(SEC_TO_MLS(NETWORK_RECONNECT_MIN_TIME), SEC_TO_MLS(NETWORK_RECONNECT_MAX_TIME));
+	reconnect.makeDefault();
 	
+	connect_ssid[0] = 0;
+	connect_pass[0] = 0;
+	connect_time = 0;
+	connect_auto_save = false;
+	connect_request = false;
+
+	memset(&cache, 0, sizeof(cache));
+	cache_attempt = false;
+
+	wifi_index = -1;
+	wifi_tried_mask = 0;
+	scan_timer = 0;
+	connected_flag = false;
+
 	reset_request = true;
-	tick_allow = true;
-	wifi_reconnect_timer = 0;
+	state = NETWORK_STATE_IDLE;
+	scan_count = WIFI_SCAN_FAILED;
+	state_timer = 0;
 }
 
 void NetworkManager::begin() {
+	readCache();
+
+	WiFi.persistent(false);
+	WiFi.setAutoReconnect(false);
+
+	connected_handler = WiFi.onStationModeConnected([this](const WiFiEventStationModeConnected& event) {
+		if (state == NETWORK_STATE_ASSOCIATING) {
+			setState(NETWORK_STATE_DHCP);
+		}
+	});
+
+	got_ip_handler = WiFi.onStationModeGotIP([this](const WiFiEventStationModeGotIP& event) {
+		if (state == NETWORK_STATE_ASSOCIATING || state == NETWORK_STATE_DHCP) {
+			setState(NETWORK_STATE_CONNECTED);
+		}
+	});
+
+	disconnected_handler = WiFi.onStationModeDisconnected([this](const WiFiEventStationModeDisconnected& event) {
+		// wrong password or a rejected association, counted like a timeout
+		if (state == NETWORK_STATE_ASSOCIATING || state == NETWORK_STATE_DHCP) {
+			reconnect.fail();
+			setState(NETWORK_STATE_BACKOFF);
+		}
+
+		else if (state == NETWORK_STATE_CONNECTED) {
+			setState(NETWORK_STATE_IDLE);
+		}
+	});
+
 	tick();
 }
 
 void NetworkManager::tick() {
-	if (!tick_allow) {
-		return;
-	}
-	
 	if (reset_request) {
 		Serial.println("reset");
 
@@ -101,14 +147,12 @@ void NetworkManager::tick() {
 	}
 
 
-	if (WiFi.getMode() == WIFI_STA || WiFi.getMode() == WIFI_AP_STA) {
-		if (getStatus() != WL_CONNECTED) {
-			connect();
-		}
+	if (isWifiOn()) {
+		connectTick();
 	}
 
 	if (!system->getSleepFlag()) {
-		web.tick();
+		PROFILE(system->getProfiler(), PROFILER_WEB, web.tick());
 	}
 }
 
@@ -122,28 +166,57 @@ bool NetworkManager::handleEvent(const char* code, void* data, uint8_t type) {
 }
 
 void NetworkManager::addObserver(IObserver* observer) {
-	
+	if (observer == NULL) {
+		return;
+	}
+
+	observers.add(observer);
 }
 
 
 void NetworkManager::writeSettings(char* buffer) {
 	setParameter(buffer, "SNm", getMode());
-	setParameter(buffer, "SNWs", (const char*) getWifiSsid());
-	setParameter(buffer, "SNWp", (const char*) getWifiPass());
 	setParameter(buffer, "SNAs", (const char*) getApSsid());
 	setParameter(buffer, "SNAp", (const char*) getApPass());
+
+	for (uint8_t i = 0;i < getWifiCount();i++) {
+		setParameter(buffer, String("SNWs") + i, (const char*) getWifiSsid(i));
+		setParameter(buffer, String("SNWp") + i, (const char*) getWifiPass(i));
+	}
 }
 
 void NetworkManager::readSettings(char* buffer) {
+	uint8_t index = 0;
+	char ssid[NETWORK_SSID_PASS_SIZE];
+	char pass[NETWORK_SSID_PASS_SIZE];
+
 	getParameter(buffer, "SNm", &mode);
-	getParameter(buffer, "SNWs", ssid_sta, NETWORK_SSID_PASS_SIZE);
-	getParameter(buffer, "SNWp", pass_sta, NETWORK_SSID_PASS_SIZE);
 	getParameter(buffer, "SNAs", ssid_ap, NETWORK_SSID_PASS_SIZE);
 	getParameter(buffer, "SNAp", pass_ap, NETWORK_SSID_PASS_SIZE);
+
+	while (getParameter(buffer, String("SNWs") + index, ssid, NETWORK_SSID_PASS_SIZE)) {
+		if (addWifi()) {
+			pass[0] = 0;
+			getParameter(buffer, String("SNWp") + index, pass, NETWORK_SSID_PASS_SIZE);
+
+			setWifi(index, ssid, pass);
+		}
+
+		index++;
+	}
+
+	// settings saved by the single network firmware
+	if (!index && getParameter(buffer, "SNWs", ssid, NETWORK_SSID_PASS_SIZE)) {
+		pass[0] = 0;
+		getParameter(buffer, "SNWp", pass, NETWORK_SSID_PASS_SIZE);
+
+		if (*ssid && addWifi()) {
+			setWifi(0, ssid, pass);
+		}
+	}
 	
 	setMode(mode);
 	setAp(ssid_ap, pass_ap);
-	setWifi(ssid_sta, pass_sta);
 }
 
 
@@ -154,44 +227,34 @@ void NetworkManager::endBegin() {
 }
 
 bool NetworkManager::connect(String ssid, String pass, uint8_t connect_time, bool auto_save) {
-	bool connect_status = false;
-	
 	if (!ssid[0]) {
-		if (!wifi_reconnect_timer || millis() - wifi_reconnect_timer >= SEC_TO_MLS(NETWORK_RECONNECT_TIME)) {
-			wifi_reconnect_timer = millis();
-			
-			WiFi.begin(getWifiSsid(), getWifiPass());
-			connect_status = getStatus();
-
-			Serial.println("connect wifi");
+		if (state == NETWORK_STATE_BACKOFF) {
+			reconnect.retryNow();
+			setState(NETWORK_STATE_IDLE);
 		}
+
+		return (state == NETWORK_STATE_CONNECTED);
 	}
-	else {
-		uint32_t connect_timer = millis();
-		tick_allow = false;
-		
-		off();
-   		WiFi.mode(WIFI_STA);
-		WiFi.begin(ssid, pass);
 
-		while (connect_time && millis() - connect_timer < SEC_TO_MLS(connect_time)) {
-			if (getStatus() == WL_CONNECTED) {
-				connect_status = true;
-				break;
-			}
-			
-			system->tick();
-		}
-		
-		if (auto_save && getStatus()) {
-			setWifi(ssid.c_str(), pass.c_str());
-		}
+	if (state == NETWORK_STATE_SCANNING) {
+		WiFi.scanDelete();
+	}
 
-   		tick_allow = true;
-		reset_request = true;
+	ssid.toCharArray(connect_ssid, NETWORK_SSID_PASS_SIZE);
+	pass.toCharArray(connect_pass, NETWORK_SSID_PASS_SIZE);
+	this->connect_time = connect_time;
+	connect_auto_save = auto_save;
+	connect_request = true;
+	wifi_index = -1;
+
+	if (WiFi.getMode() != WIFI_STA && WiFi.getMode() != WIFI_AP_STA) {
+		WiFi.mode(WIFI_AP_STA);
 	}
 
-	return connect_status;
+	WiFi.disconnect();
+	setState(NETWORK_STATE_IDLE);
+
+	return true;
 }
 
 
@@ -204,6 +267,76 @@ bool NetworkManager::isApOn() {
 }
 
 
+bool NetworkManager::addWifi() {
+	if (wifi_list.add()) {
+		network_wifi_t* wifi = &wifi_list[wifi_list.size() - 1];
+
+		wifi->ssid[0] = 0;
+		wifi->pass[0] = 0;
+		wifi->rssi = NETWORK_RSSI_NONE;
+		wifi->channel = 0;
+		memset(wifi->bssid, 0, sizeof(wifi->bssid));
+		wifi->fails = 0;
+
+		return true;
+	}
+
+	return false;
+}
+
+bool NetworkManager::deleteWifi(uint8_t index) {
+	if (!isCorrectWifiIndex(index)) {
+		return false;
+	}
+
+	if (wifi_list.del(index)) {
+		// entries above the deleted one move down by one, their index and tried bit follow
+		if (wifi_index == index) {
+			reset_request = true;
+			wifi_index = -1;
+		}
+		else if (wifi_index > index) {
+			wifi_index--;
+		}
+
+		uint8_t low_mask = (1 << index) - 1;
+		wifi_tried_mask = (wifi_tried_mask & low_mask) | ((wifi_tried_mask >> 1) & ~low_mask);
+
+		return true;
+	}
+
+	return false;
+}
+
+bool NetworkManager::saveWifi(const char* ssid, const char* pass) {
+	if (ssid == NULL || !*ssid) {
+		return false;
+	}
+
+	int8_t index = -1;
+
+	for (uint8_t i = 0;i < getWifiCount();i++) {
+		if (!strcmp(getWifiSsid(i), ssid)) {
+			index = i;
+			break;
+		}
+	}
+
+	// a full list gives up its last entry
+	if (index < 0) {
+		addWifi();
+		index = getWifiCount() - 1;
+	}
+
+	strcpy(wifi_list[index].ssid, ssid);
+	strcpy(wifi_list[index].pass, (pass != NULL) ? pass : "");
+	wifi_list[index].fails = 0;
+
+	wifi_index = index;
+	return true;
+}
+
+
 void NetworkManager::setSystemManager(SystemManager* system) {
 	this->system = system;
 	web.setSystemManager(system);
@@ -214,18 +347,28 @@ void NetworkManager::setMode(uint8_t mode) {
   	this->mode = mode;
 }
 
-void NetworkManager::setWifi(String* ssid, String* pass) {
-  	setWifi((ssid != NULL) ? ssid->c_str() : NULL, (pass != NULL) ? pass->c_str() : NULL);
+void NetworkManager::setWifi(uint8_t index, String* ssid, String* pass) {
+  	setWifi(index, (ssid != NULL) ? ssid->c_str() : NULL, (pass != NULL) ? pass->c_str() : NULL);
 }
-void NetworkManager::setWifi(const char* ssid, const char* pass) {
+void NetworkManager::setWifi(uint8_t index, const char* ssid, const char* pass) {
+	if (!isCorrectWifiIndex(index)) {
+		return;
+	}
+
 	if (ssid != NULL) {
-		strcpy(ssid_sta, ssid);
+		strcpy(wifi_list[index].ssid, ssid);
+		wifi_list[index].rssi = NETWORK_RSSI_NONE;
 	}
 	if (pass != NULL) {
-		strcpy(pass_sta, pass);
+		strcpy(wifi_list[index].pass, pass);
 	}
 
-	reset_request = true;
+	wifi_list[index].fails = 0;
+	scan_timer = 0;
+
+	if (wifi_index == index || state != NETWORK_STATE_CONNECTED) {
+		reset_request = true;
+	}
 }
 
 void NetworkManager::setAp(String* ssid, String* pass) {
@@ -249,17 +392,57 @@ wl_status_t NetworkManager::getStatus() {
   	return WiFi.status();
 }
 
+uint8_t NetworkManager::getState() {
+	return state;
+}
+
+ReconnectPolicy* NetworkManager::getReconnectPolicy() {
+	return &reconnect;
+}
+
 
 uint8_t NetworkManager::getMode() {
   	return mode;
 }
 
-char* NetworkManager::getWifiSsid() {
-  	return ssid_sta;
+uint8_t NetworkManager::getWifiCount() {
+	return wifi_list.size();
+}
+
+int8_t NetworkManager::getWifiIndex() {
+	return (state == NETWORK_STATE_CONNECTED) ? wifi_index : -1;
+}
+
+char* NetworkManager::getWifiSsid(uint8_t index) {
+	if (!isCorrectWifiIndex(index)) {
+		return NULL;
+	}
+
+  	return wifi_list[index].ssid;
+}
+
+char* NetworkManager::getWifiPass(uint8_t index) {
+	if (!isCorrectWifiIndex(index)) {
+		return NULL;
+	}
+
+  	return wifi_list[index].pass;
+}
+
+int8_t NetworkManager::getWifiRssi(uint8_t index) {
+	if (!isCorrectWifiIndex(index)) {
+		return NETWORK_RSSI_NONE;
+	}
+
+	return wifi_list[index].rssi;
 }
 
-char* NetworkManager::getWifiPass() {
-  	return pass_sta;
+uint8_t NetworkManager::getWifiFails(uint8_t index) {
+	if (!isCorrectWifiIndex(index)) {
+		return 0;
+	}
+
+	return wifi_list[index].fails;
 }
 
 char* NetworkManager::getApSsid() {
@@ -271,13 +454,344 @@ char* NetworkManager::getApPass() {
 }
 
 
+void NetworkManager::notifyObservers(String code, void* data, uint8_t type) {
+	for (uint8_t i = 0;i < observers.size();i++) {
+		observers[i]->handleEvent(code.c_str(), data, type);
+	}
+}
+
+
 void NetworkManager::off() {
 	if (!system->getSleepFlag()) {
 		web.stop();
 	}
 
+	if (state == NETWORK_STATE_SCANNING) {
+		WiFi.scanDelete();
+	}
+
 	WiFi.disconnect();
 	WiFi.mode(WIFI_OFF);
-	
-	wifi_reconnect_timer = 0;
+
+	setState(NETWORK_STATE_IDLE);
+	reconnect.reset();
+
+	if (connected_flag) {
+		connected_flag = false;
+		notifyObservers(String("/network/data/connected"), &connected_flag, TYPE_BOOL);
+	}
+}
+
+void NetworkManager::connectTick() {
+	if (connected_flag && state != NETWORK_STATE_CONNECTED) {
+		connected_flag = false;
+		notifyObservers(String("/network/data/connected"), &connected_flag, TYPE_BOOL);
+	}
+
+	if (state == NETWORK_STATE_IDLE) {
+		if (!connect_request) {
+			if (!getWifiCount()) {
+				return;
+			}
+
+			for (uint8_t i = 0;i < getWifiCount();i++) {
+				if (isCacheValid(getWifiSsid(i))) {
+					Serial.println("fast connect wifi");
+
+					wifi_index = i;
+					cache_attempt = true;
+					reconnect.attempt();
+					setState(NETWORK_STATE_ASSOCIATING);
+
+					WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+					WiFi.begin(getWifiSsid(i), getWifiPass(i), cache.channel, cache.bssid);
+					return;
+				}
+			}
+
+			if (scan_timer && millis() - scan_timer < SEC_TO_MLS(NETWORK_SCAN_CACHE_TIME)) {
+				connectBest();
+				return;
+			}
+		}
+
+		Serial.println("scan wifi");
+
+		scan_count = WIFI_SCAN_RUNNING;
+		setState(NETWORK_STATE_SCANNING);
+
+		WiFi.scanNetworksAsync([this](int count) {
+			scan_count = count;
+		});
+	}
+
+	else if (state == NETWORK_STATE_SCANNING) {
+		if (scan_count == WIFI_SCAN_RUNNING) {
+			if (millis() - state_timer >= SEC_TO_MLS(NETWORK_SCAN_TIMEOUT)) {
+				WiFi.scanDelete();
+
+				reconnect.fail();
+				setState(NETWORK_STATE_BACKOFF);
+			}
+
+			return;
+		}
+
+		if (!connect_request) {
+			updateScanResults(scan_count);
+			WiFi.scanDelete();
+
+			connectBest();
+			return;
+		}
+
+		int8_t index = scanSsidIndex(connect_ssid, scan_count);
+
+		Serial.println("connect wifi");
+
+		reconnect.attempt();
+		setState(NETWORK_STATE_ASSOCIATING);
+		WiFi.config(0U, 0U, 0U);
+
+		// a hidden network never shows up in the scan, it can still be joined by name
+		if (index < 0) {
+			WiFi.begin(connect_ssid, connect_pass);
+		}
+		else {
+			WiFi.begin(connect_ssid, connect_pass, WiFi.channel(index), WiFi.BSSID(index));
+		}
+
+		WiFi.scanDelete();
+	}
+
+	else if (state == NETWORK_STATE_ASSOCIATING || state == NETWORK_STATE_DHCP) {
+		uint8_t timeout = (connect_request && connect_time) ? connect_time : NETWORK_CONNECT_TIMEOUT;
+
+		if (cache_attempt) {
+			timeout = NETWORK_FAST_CONNECT_TIMEOUT;
+		}
+
+		if (millis() - state_timer >= SEC_TO_MLS(timeout)) {
+			Serial.println("wifi timeout");
+
+			reconnect.fail();
+			setState(NETWORK_STATE_BACKOFF);
+			WiFi.disconnect();
+		}
+	}
+
+	else if (state == NETWORK_STATE_CONNECTED) {
+		if (!connected_flag) {
+			connected_flag = true;
+
+			reconnect.success();
+			notifyObservers(String("/network/data/connected"), &connected_flag, TYPE_BOOL);
+		}
+
+		if (connect_request) {
+			if (connect_auto_save && saveWifi(connect_ssid, connect_pass)) {
+				system->saveSettingsRequest();
+			}
+
+			connect_request = false;
+		}
+
+		if (isCorrectWifiIndex(wifi_index)) {
+			if (!cache_attempt && !isCacheValid(getWifiSsid(wifi_index))) {
+				writeCache();
+			}
+
+			wifi_list[wifi_index].fails = 0;
+		}
+
+		cache_attempt = false;
+		wifi_tried_mask = 0;
+	}
+
+	else if (state == NETWORK_STATE_BACKOFF) {
+		if (cache_attempt) {
+			Serial.println("fast connect failed");
+
+			// stale BSSID or lease, fall back to a full scan and DHCP right away
+			cache_attempt = false;
+			wifi_index = -1;
+			clearCache();
+
+			setState(NETWORK_STATE_IDLE);
+		}
+
+		// the requested network failed, the saved ones take over after the usual wait
+		else if (connect_request) {
+			connect_request = false;
+		}
+
+		else if (wifi_index >= 0) {
+			Serial.println("wifi failed");
+
+			if (isCorrectWifiIndex(wifi_index) && wifi_list[wifi_index].fails < NETWORK_FAILS_MAX) {
+				wifi_list[wifi_index].fails++;
+			}
+
+			// skip straight to the next candidate of this round
+			wifi_index = -1;
+			connectBest();
+		}
+
+		else if (reconnect.isReady()) {
+			setState(NETWORK_STATE_IDLE);
+		}
+	}
+}
+
+void NetworkManager::setState(uint8_t state) {
+	this->state = state;
+	state_timer = millis();
+}
+
+bool NetworkManager::isCacheValid(const char* ssid) {
+	if (!cache.ip || !cache.channel) {
+		return false;
+	}
+
+	return !strcmp(cache.ssid, ssid);
+}
+
+void NetworkManager::readCache() {
+	ESP.rtcUserMemoryRead(RTC_NETWORK_CACHE_BLOCK, (uint32_t*) &cache, sizeof(cache));
+
+	if (cache.crc != calcCrc32((uint8_t*) &cache + sizeof(cache.crc), sizeof(cache) - sizeof(cache.crc))) {
+		memset(&cache, 0, sizeof(cache));
+	}
+}
+
+void NetworkManager::writeCache() {
+	WiFi.SSID().toCharArray(cache.ssid, NETWORK_SSID_PASS_SIZE);
+	memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+	cache.channel = WiFi.channel();
+	cache.ip = WiFi.localIP();
+	cache.gateway = WiFi.gatewayIP();
+	cache.subnet = WiFi.subnetMask();
+	cache.dns = WiFi.dnsIP(0);
+
+	cache.crc = calcCrc32((uint8_t*) &cache + sizeof(cache.crc), sizeof(cache) - sizeof(cache.crc));
+	ESP.rtcUserMemoryWrite(RTC_NETWORK_CACHE_BLOCK, (uint32_t*) &cache, sizeof(cache));
+}
+
+void NetworkManager::clearCache() {
+	memset(&cache, 0, sizeof(cache));
+	ESP.rtcUserMemoryWrite(RTC_NETWORK_CACHE_BLOCK, (uint32_t*) &cache, sizeof(cache));
+}
+
+void NetworkManager::updateScanResults(int16_t count) {
+	for (uint8_t i = 0;i < getWifiCount();i++) {
+		wifi_list[i].rssi = NETWORK_RSSI_NONE;
+	}
+
+	for (int16_t i = 0;i < count;i++) {
+		String ssid = WiFi.SSID(i);
+		int8_t rssi = constrain(WiFi.RSSI(i), NETWORK_RSSI_NONE + 1, 0);
+
+		for (uint8_t j = 0;j < getWifiCount();j++) {
+			network_wifi_t* wifi = &wifi_list[j];
+
+			if (rssi <= wifi->rssi || strcmp(ssid.c_str(), wifi->ssid)) {
+				continue;
+			}
+
+			wifi->rssi = rssi;
+			wifi->channel = WiFi.channel(i);
+			memcpy(wifi->bssid, WiFi.BSSID(i), sizeof(wifi->bssid));
+		}
+	}
+
+	scan_timer = millis();
+}
+
+bool NetworkManager::connectBest() {
+	int8_t index = -1;
+	int8_t hidden_index = -1;
+	int16_t index_score = 0;
+
+	// rank the visible networks by RSSI, minus a penalty for every recent failure
+	for (uint8_t i = 0;i < getWifiCount();i++) {
+		int16_t score = wifi_list[i].rssi - wifi_list[i].fails * NETWORK_FAIL_PENALTY;
+
+		if (wifi_tried_mask & (1 << i)) {
+			continue;
+		}
+
+		// not in the scan, possibly hidden, tried once the visible ones are used up
+		if (wifi_list[i].rssi == NETWORK_RSSI_NONE) {
+			if (hidden_index < 0) {
+				hidden_index = i;
+			}
+
+			continue;
+		}
+
+		if (index < 0 || score > index_score) {
+			index = i;
+			index_score = score;
+		}
+	}
+
+	if (index < 0) {
+		index = hidden_index;
+	}
+
+	if (index < 0) {
+		Serial.println("wifi not found");
+
+		wifi_index = -1;
+		wifi_tried_mask = 0;
+		scan_timer = 0;
+
+		reconnect.fail();
+		setState(NETWORK_STATE_BACKOFF);
+		return false;
+	}
+
+	Serial.print("connect wifi ");
+	Serial.println(getWifiSsid(index));
+
+	wifi_index = index;
+	wifi_tried_mask |= 1 << index;
+
+	reconnect.attempt();
+	setState(NETWORK_STATE_ASSOCIATING);
+
+	WiFi.config(0U, 0U, 0U);
+
+	if (wifi_list[index].rssi == NETWORK_RSSI_NONE) {
+		WiFi.begin(getWifiSsid(index), getWifiPass(index));
+	}
+	else {
+		WiFi.begin(getWifiSsid(index), getWifiPass(index), wifi_list[index].channel, wifi_list[index].bssid);
+	}
+
+	return true;
+}
+
+bool NetworkManager::isCorrectWifiIndex(uint8_t index) {
+	if (index >= getWifiCount()) {
+		return false;
+	}
+
+	return true;
+}
+
+int8_t NetworkManager::scanSsidIndex(const char* ssid, int16_t count) {
+	int8_t index = -1;
+
+	for (int16_t i = 0;i < count && i < INT8_MAX;i++) {
+		if (strcmp(WiFi.SSID(i).c_str(), ssid)) {
+			continue;
+		}
+
+		if (index < 0 || WiFi.RSSI(i) > WiFi.RSSI(index)) {
+			index = i;
+		}
+	}
+
+	return index;
 }
\ No newline at end of file
@@ -0,0 +1,146 @@
+/*
+ * Project: Temperature Tick
+ *
+ * Author: Vereshchynskyi Nazar
+ * Email: verechnazar12@gmail.com
+ * Version: 1.0.0
+ * Date: 02.03.2025
+ */
+
+#include "data.h"
+
+#if PROFILER_ENABLED
+
+Profiler::Profiler() {
+	makeDefault();
+}
+
+
+void Profiler::makeDefault() {
+	memset(slots, 0, sizeof(slots));
+
+	for (uint8_t i = 0;i < PROFILER_SLOTS_COUNT;i++) {
+		slots[i].min = UINT32_MAX;
+	}
+}
+
+void Profiler::addSample(uint8_t slot, uint32_t time) {
+	if (!isCorrectSlot(slot)) {
+		return;
+	}
+
+	profiler_slot_t* data = &slots[slot];
+
+	data->count++;
+	data->buckets[timeToBucket(time)]++;
+
+	if (time < data->min) {
+		data->min = time;
+	}
+	if (time > data->max) {
+		data->max = time;
+	}
+}
+
+uint16_t Profiler::printSlot(uint8_t slot, char* buffer, uint16_t size) {
+	if (!isCorrectSlot(slot) || buffer == NULL || !size) {
+		return 0;
+	}
+
+	int length = snprintf(buffer, size, "{\"n\":%u,\"min\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u,\"h\":[",
+		getCount(slot), getMin(slot), getPercentile(slot, 50), getPercentile(slot, 99), getMax(slot));
+
+	for (uint8_t i = 0;i < PROFILER_BUCKETS_COUNT && length < size;i++) {
+		length += snprintf(buffer + length, size - length, (i) ? ",%u" : "%u", getBucket(slot, i));
+	}
+
+	if (length < size) {
+		length += snprintf(buffer + length, size - length, "]}");
+	}
+
+	return (length < size) ? length : size - 1;
+}
+
+
+const char* Profiler::getSlotName(uint8_t slot) {
+	static const char* names[PROFILER_SLOTS_COUNT] = {"sensors", "relay", "network", "web", "mqtt", "blynk", "loop", "mqtt_latency_ms", "blynk_login"};
+
+	if (!isCorrectSlot(slot)) {
+		return "";
+	}
+
+	return names[slot];
+}
+
+uint32_t Profiler::getCount(uint8_t slot) {
+	if (!isCorrectSlot(slot)) {
+		return 0;
+	}
+
+	return slots[slot].count;
+}
+
+uint32_t Profiler::getMin(uint8_t slot) {
+	if (!isCorrectSlot(slot) || !slots[slot].count) {
+		return 0;
+	}
+
+	return slots[slot].min;
+}
+
+uint32_t Profiler::getMax(uint8_t slot) {
+	if (!isCorrectSlot(slot)) {
+		return 0;
+	}
+
+	return slots[slot].max;
+}
+
+uint32_t Profiler::getPercentile(uint8_t slot, uint8_t percent) {
+	if (!isCorrectSlot(slot) || !slots[slot].count) {
+		return 0;
+	}
+
+	// upper bound of the bucket that holds the requested rank, clamped to the real min/max
+	uint32_t rank = ((uint64_t) slots[slot].count * constrain(percent, 1, 100) + 99) / 100;
+	uint32_t passed = 0;
+
+	for (uint8_t i = 0;i < PROFILER_BUCKETS_COUNT;i++) {
+		passed += slots[slot].buckets[i];
+
+		if (passed >= rank) {
+			uint32_t bound = (i) ? (1UL << i) - 1 : 0;
+			return constrain(bound, getMin(slot), getMax(slot));
+		}
+	}
+
+	return getMax(slot);
+}
+
+uint32_t Profiler::getBucket(uint8_t slot, uint8_t bucket) {
+	if (!isCorrectSlot(slot) || bucket >= PROFILER_BUCKETS_COUNT) {
+		return 0;
+	}
+
+	return slots[slot].buckets[bucket];
+}
+
+
+bool Profiler::isCorrectSlot(uint8_t slot) {
+	if (slot >= PROFILER_SLOTS_COUNT) {
+		return false;
+	}
+
+	return true;
+}
+
+uint8_t Profiler::timeToBucket(uint32_t time) {
+	if (!time) {
+		return 0;
+	}
+
+	uint8_t bucket = 32 - __builtin_clz(time);
+	return (bucket < PROFILER_BUCKETS_COUNT) ? bucket : PROFILER_BUCKETS_COUNT - 1;
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Project: Temperature Tick
+ *
+ * Author: Vereshchynskyi Nazar
+ * Email: verechnazar12@gmail.com
+ * Version: 1.0.0
+ * Date: 02.03.2025
+ */
+
+#include "data.h"
+
+ReconnectPolicy::ReconnectPolicy() {
+	setLimits(SEC_TO_MLS(RECONNECT_MIN_TIME), SEC_TO_MLS(RECONNECT_MAX_TIME));
+	makeDefault();
+}
+
+
+void ReconnectPolicy::makeDefault() {
+	reset();
+
+	total_attempts = 0;
+	connects = 0;
+	connect_time = 0;
+}
+
+void ReconnectPolicy::reset() {
+	attempts = 0;
+	backoff_time = 0;
+	wait_time = 0;
+	wait_timer = 0;
+	series_timer = 0;
+}
+
+
+bool ReconnectPolicy::isReady() {
+	if (!wait_time) {
+		return true;
+	}
+
+	return millis() - wait_timer >= wait_time;
+}
+
+void ReconnectPolicy::attempt() {
+	if (!attempts) {
+		series_timer = millis();
+	}
+
+	attempts++;
+	total_attempts++;
+	wait_time = 0;
+}
+
+void ReconnectPolicy::fail() {
+	backoff_time = (backoff_time) ? min(backoff_time * 2, max_time) : min_time;
+
+	// equal jitter: half of the delay is fixed, the other half is random
+	wait_time = backoff_time / 2 + ESP.random() % (backoff_time / 2 + 1);
+	wait_timer = millis();
+}
+
+void ReconnectPolicy::success() {
+	connect_time = (attempts) ? millis() - series_timer : 0;
+	connects++;
+
+	reset();
+}
+
+void ReconnectPolicy::retryNow() {
+	backoff_time = 0;
+	wait_time = 0;
+}
+
+
+uint16_t ReconnectPolicy::print(char* buffer, uint16_t size) {
+	if (buffer == NULL || !size) {
+		return 0;
+	}
+
+	int length = snprintf(buffer, size, "{\"n\":%u,\"total\":%u,\"connects\":%u,\"ttc\":%u,\"wait\":%u}",
+		getAttempts(), getTotalAttempts(), getConnects(), getConnectTime(), getWaitTime());
+
+	return (length < size) ? length : size - 1;
+}
+
+
+void ReconnectPolicy::setLimits(uint32_t min_time, uint32_t max_time) {
+	this->min_time = max(min_time, (uint32_t) 2);
+	this->max_time = max(max_time, this->min_time);
+}
+
+
+uint32_t ReconnectPolicy::getAttempts() {
+	return attempts;
+}
+
+uint32_t ReconnectPolicy::getTotalAttempts() {
+	return total_attempts;
+}
+
+uint32_t ReconnectPolicy::getConnects() {
+	return connects;
+}
+
+uint32_t ReconnectPolicy::getConnectTime() {
+	return connect_time;
+}
+
+uint32_t ReconnectPolicy::getWaitTime() {
+	if (isReady()) {
+		return 0;
+	}
+
+	return wait_time - (millis() - wait_timer);
+}
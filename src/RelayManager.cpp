@@ -9,6 +9,8 @@
 
 #include "data.h"
 
+static const uint8_t relay_ports[RELAY_CHANNELS_COUNT] = RELAY_PORTS;
+
 RelayManager::RelayManager() {
 	makeDefault();
 }
@@ -19,71 +21,510 @@ void RelayManager::makeDefault() {
 	system = NULL;
 
 	/* --- settings --- */
-	invert_flag = DEFAULT_RELAY_INVERT_FLAG;
-	mode = DEFAULT_RELAY_MODE;
+	min_on_time = DEFAULT_RELAY_MIN_ON_TIME;
+	min_off_time = DEFAULT_RELAY_MIN_OFF_TIME;
+	max_switches = DEFAULT_RELAY_MAX_SWITCHES;
+
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		invert_flag[i] = DEFAULT_RELAY_INVERT_FLAG;
+		mode[i] = DEFAULT_RELAY_MODE;
 
-	therm_sensor_index = DEFAULT_RELAY_THERM_SENSOR_INDEX;
-	therm_set_t = DEFAULT_RELAY_THERM_T;
-	therm_delta = DEFAULT_RELAY_THERM_DELTA;
-	therm_mode = DEFAULT_RELAY_THERM_MODE;
-	therm_error_relay_flag = DEFAULT_RELAY_THERM_ERROR_RELE_FLAG;
+		therm_sensor_index[i] = DEFAULT_RELAY_THERM_SENSOR_INDEX;
+		therm_set_t[i] = DEFAULT_RELAY_THERM_T;
+		therm_delta[i] = DEFAULT_RELAY_THERM_DELTA;
+		therm_mode[i] = DEFAULT_RELAY_THERM_MODE;
+		therm_error_relay_flag[i] = DEFAULT_RELAY_THERM_ERROR_RELE_FLAG;
+
+		pid_kp[i] = DEFAULT_RELAY_PID_KP * RELAY_PID_GAIN_SCALE;
+		pid_ki[i] = DEFAULT_RELAY_PID_KI * RELAY_PID_GAIN_SCALE;
+		pid_kd[i] = DEFAULT_RELAY_PID_KD * RELAY_PID_GAIN_SCALE;
+		pid_window[i] = DEFAULT_RELAY_PID_WINDOW;
+
+		schedule_flag[i] = DEFAULT_RELAY_SCHEDULE_FLAG;
+		memset(periods[i], 0, sizeof(periods[i]));
+		periods_count[i] = 0;
+	}
 
 	/* --- variables --- */
 	observers.clear();
-	relay_flag = false;
+	begin_flag = false;
+
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		strlcpy(flag_codes[i], makeCode("/relay/settings/relay_flag", i).c_str(), RELAY_CODE_SIZE);
+
+		relay_flag[i] = false;
+		output_level[i] = RELAY_OUTPUT_UNKNOWN;
+		resetPid(i);
+
+		pending_flag[i] = false;
+		pending_relay_flag[i] = false;
+		switch_timer[i] = 0;
+		switch_tokens[i] = max_switches * 1000;
+		switch_tokens_timer[i] = 0;
+
+		memset(&stats[i], 0, sizeof(relay_stats_t));
+		stats_timer[i] = 0;
+		on_time_ms[i] = 0;
+		on_time_hour[i] = 0;
+		on_time_day[i] = 0;
+
+		transitions_count[i] = 0;
+		schedule_index[i] = 0;
+		schedule_next[i] = 0;
+		schedule_status[i] = false;
+		schedule_t[i] = 0;
+
+		override_flag[i] = false;
+		override_t[i] = 0;
+		override_time[i] = 0;
+		override_timer[i] = 0;
+		target_t[i] = DEFAULT_RELAY_THERM_T;
+	}
+
+	stats_hour_timer = 0;
+	stats_hours = 0;
 }
 
 void RelayManager::begin() {
-	pinMode(RELAY_PORT, OUTPUT);
-	setRelayFlag(false);
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		pinMode(relay_ports[i], OUTPUT);
+
+		relay_flag[i] = false;
+		output_level[i] = RELAY_OUTPUT_UNKNOWN;
+		relayTick(i);
+	}
+
+	// counters from before a reset or a deep sleep are newer than the saved settings
+	readStatsCache();
+
+	// settings and the first reading arrive before begin(), evaluate them now
+	begin_flag = true;
+
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		thermTick(i);
+	}
 }
 
 void RelayManager::tick() {
-	SensorsManager* sensors = system->getSensorsManager();
-	relayTick();
+	time_t now = SystemManager::getClockTime();
+
+	// the controllers run from sensor and settings events, only the PID window, the schedule and the guards are timed
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		if (schedule_next[i] && now >= schedule_next[i]) {
+			scheduleTick(i, now);
+		}
+
+		if (override_flag[i] && override_time[i] && millis() - override_timer[i] >= MIN_TO_MLS((uint32_t) override_time[i])) {
+			cancelOverride(i);
+		}
+
+		if (getMode(i) == RELAY_MODE_PID) {
+			pidWindowTick(i);
+		}
+
+		if (pending_flag[i]) {
+			controlRelayFlag(i, pending_relay_flag[i]);
+		}
+	}
+
+	statsTick();
+}
+
+void RelayManager::thermTick(uint8_t channel, bool sample_flag) {
+	if (!begin_flag || !isCorrectChannel(channel)) {
+		return;
+	}
 
-	if (getMode() == RELAY_MODE_SIMPLE) {
+	SensorsManager* sensors = system->getSensorsManager();
 
+	if (getMode(channel) == RELAY_MODE_PID) {
+		pidTick(channel, sample_flag);
 	}
 
-	else if (getMode() == RELAY_MODE_THERM) {
-		if (!getThermStatus()) {
-			float t = sensors->getDS18B20T(getThermSensor());
+	else if (getMode(channel) == RELAY_MODE_THERM) {
+		if (!getThermStatus(channel)) {
+			float t = sensors->getDS18B20T(getThermSensor(channel));
 
-			if (getThermMode() == RELAY_THERM_MODE_HEATING) {
-				if (t >= getThermSetT()) {
-					setRelayFlag(false);
+			if (getThermMode(channel) == RELAY_THERM_MODE_HEATING) {
+				if (t >= getTargetT(channel)) {
+					controlRelayFlag(channel, false);
 				}
 
-				else if (t <= getThermSetT() - getThermDelta()) {
-					setRelayFlag(true);
+				else if (t <= getTargetT(channel) - getThermDelta(channel)) {
+					controlRelayFlag(channel, true);
 				}
 			}
 
-			else if (getThermMode() == RELAY_THERM_MODE_COOLING) {
-				if (t >= getThermSetT() + getThermDelta()) {
-					setRelayFlag(true);
+			else if (getThermMode(channel) == RELAY_THERM_MODE_COOLING) {
+				if (t >= getTargetT(channel) + getThermDelta(channel)) {
+					controlRelayFlag(channel, true);
 				}
 
-				else if (t <= getThermSetT()) {
-					setRelayFlag(false);
+				else if (t <= getTargetT(channel)) {
+					controlRelayFlag(channel, false);
 				}
 			}
 		}
 
 		else {
-			setRelayFlag(getThermErrorRelayFlag());
+			controlRelayFlag(channel, getThermErrorRelayFlag(channel));
+		}
+	}
+}
+
+void RelayManager::pidTick(uint8_t channel, bool sample_flag) {
+	if (getThermStatus(channel)) {
+		resetPid(channel);
+		pid_duty[channel] = getThermErrorRelayFlag(channel) ? RELAY_PID_DUTY_MAX : 0;
+
+		pidWindowTick(channel);
+		return;
+	}
+
+	int32_t t = getThermT(channel) * RELAY_PID_T_SCALE;
+	int32_t error = getTargetT(channel) * RELAY_PID_T_SCALE - t;
+	int32_t slope = 0;
+	uint32_t dt = 0;
+
+	if (getThermMode(channel) == RELAY_THERM_MODE_COOLING) {
+		error = -error;
+	}
+
+	// integral and derivative only advance on a new reading, settings changes just recompute the output
+	if (sample_flag) {
+		dt = (pid_timer[channel]) ? (millis() - pid_timer[channel]) / 1000 : 0;
+		pid_timer[channel] = millis();
+
+		// on the measurement rather than the error, so a setpoint change doesn't kick
+		if (dt) {
+			slope = (int64_t) (pid_prev_t[channel] - t) * 60 / (int32_t) dt;
+
+			if (getThermMode(channel) == RELAY_THERM_MODE_COOLING) {
+				slope = -slope;
+			}
+
+			pid_derivative[channel] += (slope - pid_derivative[channel]) / RELAY_PID_D_FILTER;
+		}
+
+		pid_prev_t[channel] = t;
+	}
+
+	// gains are per degree and per minute, the terms come out in permille
+	int64_t scale = (int64_t) RELAY_PID_GAIN_SCALE * RELAY_PID_T_SCALE;
+	int32_t output = ((int64_t) pid_kp[channel] * error + (int64_t) pid_kd[channel] * pid_derivative[channel]) / scale;
+	int32_t saturated = output + (int64_t) pid_ki[channel] * pid_integral[channel] / (scale * 60);
+
+	// anti-windup: no integration further into a saturated output
+	if (!(saturated >= RELAY_PID_DUTY_MAX && error > 0) && !(saturated <= 0 && error < 0)) {
+		pid_integral[channel] += error * (int32_t) dt;
+	}
+
+	// and the integral alone never asks for more than the whole window
+	if (pid_ki[channel] > 0) {
+		pid_integral[channel] = constrain(pid_integral[channel], 0, (int32_t) (RELAY_PID_DUTY_MAX * scale * 60 / pid_ki[channel]));
+	}
+	else {
+		pid_integral[channel] = 0;
+	}
+
+	output += (int64_t) pid_ki[channel] * pid_integral[channel] / (scale * 60);
+	pid_duty[channel] = constrain(output, 0, RELAY_PID_DUTY_MAX);
+
+	if (sample_flag) {
+		notifyObservers(makeCode("/relay/data/duty", channel), &pid_duty[channel], TYPE_UINT16_T);
+	}
+
+	pidWindowTick(channel);
+}
+
+void RelayManager::pidWindowTick(uint8_t channel) {
+	uint32_t window = SEC_TO_MLS(getPidWindow(channel));
+
+	if (!pid_window_timer[channel] || millis() - pid_window_timer[channel] >= window) {
+		pid_window_timer[channel] = millis();
+	}
+
+	// slow PWM: on for the duty share at the start of each window
+	controlRelayFlag(channel, millis() - pid_window_timer[channel] < (uint64_t) window * pid_duty[channel] / RELAY_PID_DUTY_MAX);
+}
+
+void RelayManager::controlRelayFlag(uint8_t channel, bool relay_flag) {
+	if (relay_flag == getRelayFlag(channel)) {
+		pending_flag[channel] = false;
+		return;
+	}
+
+	// noise near a boundary must not chatter the contacts, the switch waits for the guard instead
+	if (!isSwitchAllowed(channel)) {
+		pending_flag[channel] = true;
+		pending_relay_flag[channel] = relay_flag;
+		return;
+	}
+
+	pending_flag[channel] = false;
+	if (getMaxSwitches()) {
+		switch_tokens[channel] -= 1000;
+	}
+
+	setRelayFlag(channel, relay_flag);
+}
+
+bool RelayManager::isSwitchAllowed(uint8_t channel) {
+	uint16_t dwell = getRelayFlag(channel) ? getMinOnTime() : getMinOffTime();
+
+	if (switch_timer[channel] && millis() - switch_timer[channel] < SEC_TO_MLS(dwell)) {
+		return false;
+	}
+
+	if (!getMaxSwitches()) {
+		return true;
+	}
+
+	// token bucket refilled at max_switches per hour
+	uint32_t elapsed = min(millis() - switch_tokens_timer[channel], RELAY_STATS_HOUR);
+	switch_tokens[channel] = min(switch_tokens[channel] + (uint32_t) ((uint64_t) elapsed * getMaxSwitches() * 1000 / RELAY_STATS_HOUR), (uint32_t) getMaxSwitches() * 1000);
+	switch_tokens_timer[channel] = millis();
+
+	return switch_tokens[channel] >= 1000;
+}
+
+void RelayManager::updateStats(uint8_t channel) {
+	uint32_t elapsed = millis() - stats_timer[channel];
+	stats_timer[channel] = millis();
+
+	if (!getRelayFlag(channel)) {
+		return;
+	}
+
+	on_time_hour[channel] += elapsed;
+	on_time_day[channel] += elapsed;
+	on_time_ms[channel] += elapsed;
+
+	stats[channel].on_time += on_time_ms[channel] / 1000;
+	on_time_ms[channel] %= 1000;
+}
+
+void RelayManager::statsTick() {
+	if (millis() - stats_hour_timer < RELAY_STATS_HOUR) {
+		return;
+	}
+	stats_hour_timer += RELAY_STATS_HOUR;
+
+	bool day_flag = (++stats_hours >= RELAY_STATS_DAY_HOURS);
+	if (day_flag) {
+		stats_hours = 0;
+	}
+
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		updateStats(i);
+
+		stats[i].duty_hour = (uint64_t) min(on_time_hour[i], RELAY_STATS_HOUR) * 1000 / RELAY_STATS_HOUR;
+		on_time_hour[i] = 0;
+
+		if (day_flag) {
+			stats[i].duty_day = (uint64_t) on_time_day[i] * 1000 / (RELAY_STATS_HOUR * RELAY_STATS_DAY_HOURS);
+			on_time_day[i] = 0;
 		}
+
+		notifyObservers(makeCode("/relay/data/cycles", i), &stats[i].cycles, TYPE_UINT32_T);
+		notifyObservers(makeCode("/relay/data/on_time", i), &stats[i].on_time, TYPE_UINT32_T);
+		notifyObservers(makeCode("/relay/data/duty_hour", i), &stats[i].duty_hour, TYPE_UINT16_T);
+		notifyObservers(makeCode("/relay/data/duty_day", i), &stats[i].duty_day, TYPE_UINT16_T);
+	}
+
+	// RTC memory survives resets and deep sleep, the flash copy for a power loss is refreshed once a day
+	writeStatsCache();
+
+	if (day_flag) {
+		system->saveSettingsRequest();
 	}
 }
 
+void RelayManager::readStatsCache() {
+	relay_stats_cache_t cache;
+	ESP.rtcUserMemoryRead(RTC_RELAY_STATS_BLOCK, (uint32_t*) &cache, sizeof(cache));
+
+	if (cache.crc != calcCrc32((uint8_t*) &cache + sizeof(cache.crc), sizeof(cache) - sizeof(cache.crc))) {
+		return;
+	}
+
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		stats[i] = cache.stats[i];
+		stats_timer[i] = millis();
+		on_time_ms[i] = cache.on_time_ms[i];
+		on_time_hour[i] = cache.on_time_hour[i];
+		on_time_day[i] = cache.on_time_day[i];
+	}
+
+	// millis() restarts on every wake, the hour carries on from where it stopped
+	stats_hour_timer = millis() - cache.elapsed;
+	stats_hours = cache.hours;
+}
+
+void RelayManager::writeStatsCache(uint32_t sleep_time) {
+	relay_stats_cache_t cache;
+
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		updateStats(i);
+
+		cache.stats[i] = stats[i];
+		cache.on_time_ms[i] = on_time_ms[i];
+		cache.on_time_hour[i] = on_time_hour[i];
+		cache.on_time_day[i] = on_time_day[i];
+	}
+
+	// the relay is released during deep sleep, so the sleep only adds off time
+	cache.elapsed = millis() - stats_hour_timer + sleep_time;
+	cache.hours = stats_hours;
+	cache.crc = calcCrc32((uint8_t*) &cache + sizeof(cache.crc), sizeof(cache) - sizeof(cache.crc));
+
+	ESP.rtcUserMemoryWrite(RTC_RELAY_STATS_BLOCK, (uint32_t*) &cache, sizeof(cache));
+}
+
+void RelayManager::compileSchedule(uint8_t channel) {
+	uint8_t count = 0;
+
+	// every day of every period becomes one transition, kept sorted by the minute of the week
+	for (uint8_t i = 0;i < periods_count[channel];i++) {
+		relay_period_t* period = &periods[channel][i];
+
+		for (uint8_t day = 0;day < 7;day++) {
+			if (!(period->days & (1 << day))) {
+				continue;
+			}
+
+			relay_transition_t transition = {(uint16_t) (day * RELAY_DAY_MINUTES + period->start), period->t};
+			uint8_t j = 0;
+
+			while (j < count && transitions[channel][j].minute < transition.minute) {
+				j++;
+			}
+
+			// a later period starting at the same minute wins
+			if (j < count && transitions[channel][j].minute == transition.minute) {
+				transitions[channel][j] = transition;
+				continue;
+			}
+
+			memmove(&transitions[channel][j + 1], &transitions[channel][j], (count - j) * sizeof(relay_transition_t));
+			transitions[channel][j] = transition;
+			count++;
+		}
+	}
+
+	transitions_count[channel] = count;
+	syncSchedule(channel, SystemManager::getClockTime());
+}
+
+void RelayManager::syncSchedule(uint8_t channel, time_t now) {
+	uint8_t count = transitions_count[channel];
+	schedule_next[channel] = 0;
+
+	if (!getScheduleFlag(channel) || !count || !now) {
+		schedule_status[channel] = false;
+		updateTarget(channel);
+
+		return;
+	}
+
+	struct tm local;
+	localtime_r(&now, &local);
+
+	// the first transition still ahead this week, the one before it is in effect
+	uint16_t minute = calcWeekMinute(&local);
+	uint8_t index = 0;
+
+	while (index < count && transitions[channel][index].minute <= minute) {
+		index++;
+	}
+
+	schedule_t[channel] = transitions[channel][(index + count - 1) % count].t;
+	schedule_index[channel] = index % count;
+	schedule_next[channel] = calcTransitionTime(channel, now);
+	schedule_status[channel] = true;
+
+	updateTarget(channel);
+}
+
+void RelayManager::scheduleTick(uint8_t channel, time_t now) {
+	// more than a minute late the next transitions may have passed as well, find the place again
+	if (now - schedule_next[channel] >= 60) {
+		syncSchedule(channel, now);
+		return;
+	}
+
+	schedule_t[channel] = transitions[channel][schedule_index[channel]].t;
+	schedule_index[channel] = (schedule_index[channel] + 1) % transitions_count[channel];
+	schedule_next[channel] = calcTransitionTime(channel, now);
+
+	// an override without a duration lasts until the schedule moves on
+	if (override_flag[channel] && !override_time[channel]) {
+		override_flag[channel] = false;
+	}
+
+	updateTarget(channel);
+}
+
+time_t RelayManager::calcTransitionTime(uint8_t channel, time_t now) {
+	struct tm local;
+	localtime_r(&now, &local);
+
+	uint16_t minute = calcWeekMinute(&local);
+	uint16_t delta = (transitions[channel][schedule_index[channel]].minute + RELAY_WEEK_MINUTES - minute) % RELAY_WEEK_MINUTES;
+
+	// a single transition comes round again in a week, otherwise the same minute means it is due now
+	if (!delta && transitions_count[channel] == 1) {
+		delta = RELAY_WEEK_MINUTES;
+	}
+
+	// through mktime, so a DST change before the transition is accounted for
+	local.tm_min += delta;
+	local.tm_sec = 0;
+	local.tm_isdst = -1;
+
+	return mktime(&local);
+}
+
+uint16_t RelayManager::calcWeekMinute(struct tm* local) {
+	// the week starts on Monday, tm_wday on Sunday
+	return ((local->tm_wday + 6) % 7) * RELAY_DAY_MINUTES + local->tm_hour * 60 + local->tm_min;
+}
+
+void RelayManager::updateTarget(uint8_t channel) {
+	float t = getTargetT(channel);
+
+	if (t != target_t[channel]) {
+		target_t[channel] = t;
+		notifyObservers(makeCode("/relay/data/target_t", channel), &target_t[channel], TYPE_FLOAT);
+	}
+
+	thermTick(channel);
+}
+
+void RelayManager::resetPid(uint8_t channel) {
+	pid_integral[channel] = 0;
+	pid_derivative[channel] = 0;
+	pid_prev_t[channel] = 0;
+	pid_timer[channel] = 0;
+	pid_window_timer[channel] = 0;
+	pid_duty[channel] = 0;
+}
+
 void RelayManager::addElementCodes(DynamicArray<String>* array) {
 	if (array == NULL) {
 		return;
 	}
 
-	array->add(String("/relay/data/relay_flag"));
-	array->add(String("/relay/settings/relay_flag"));
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		array->add(makeCode("/relay/data/relay_flag", i));
+		array->add(makeCode("/relay/data/duty", i));
+		array->add(makeCode("/relay/data/target_t", i));
+		array->add(makeCode("/relay/data/cycles", i));
+		array->add(makeCode("/relay/data/on_time", i));
+		array->add(makeCode("/relay/data/duty_hour", i));
+		array->add(makeCode("/relay/data/duty_day", i));
+		array->add(String(getFlagCode(i)));
+	}
 }
 
 
@@ -96,9 +537,20 @@ void RelayManager::addObserver(IObserver* observer) {
 }
 
 bool RelayManager::handleEvent(const char* code, void* data, uint8_t type) {
-	if (!strcmp(code, "/relay/settings/relay_flag")) {
-		setRelayFlag(POINTER_TO_TYPE(data, type));
-		return true;
+	if (!strcmp(code, "/sensors/data/updated")) {
+		// every channel in one pass over the fresh readings
+		for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+			thermTick(i, true);
+		}
+
+		return false;
+	}
+
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		if (!strcmp(code, getFlagCode(i))) {
+			setRelayFlag(i, POINTER_TO_TYPE(data, type));
+			return true;
+		}
 	}
 
 	if (strstr(code, "/relay/data") != NULL) {
@@ -110,128 +562,618 @@ bool RelayManager::handleEvent(const char* code, void* data, uint8_t type) {
 
 
 void RelayManager::writeSettings(char* buffer) {
-	setParameter(buffer, "RSif", getInvertFlag());
-	setParameter(buffer, "RSm", getMode());
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		setParameter(buffer, makeKey("RSif", i), getInvertFlag(i));
+		setParameter(buffer, makeKey("RSm", i), getMode(i));
+
+		setParameter(buffer, makeKey("RSTsi", i), getThermSensor(i));
+		setParameter(buffer, makeKey("RSTst", i), getThermSetT(i));
+		setParameter(buffer, makeKey("RSTd", i), getThermDelta(i));
+		setParameter(buffer, makeKey("RSTm", i), getThermMode(i));
+		setParameter(buffer, makeKey("RSTerf", i), getThermErrorRelayFlag(i));
+
+		setParameter(buffer, makeKey("RSPp", i), getPidKp(i));
+		setParameter(buffer, makeKey("RSPi", i), getPidKi(i));
+		setParameter(buffer, makeKey("RSPd", i), getPidKd(i));
+		setParameter(buffer, makeKey("RSPw", i), getPidWindow(i));
+
+		setParameter(buffer, makeKey("RSHf", i), getScheduleFlag(i));
+		setParameter(buffer, makeKey("RSHn", i), getPeriodsCount(i));
+		if (getPeriodsCount(i)) {
+			setParameter(buffer, makeKey("RSHp", i), (uint8_t*) periods[i], getPeriodsCount(i) * sizeof(relay_period_t));
+		}
 
-	setParameter(buffer, "RSTsi", getThermSensor());
-	setParameter(buffer, "RSTst", getThermSetT());
-	setParameter(buffer, "RSTd", getThermDelta());
-	setParameter(buffer, "RSTm", getThermMode());
-	setParameter(buffer, "RSTerf", getThermErrorRelayFlag());
+		updateStats(i);
+		setParameter(buffer, makeKey("RSSc", i), stats[i].cycles);
+		setParameter(buffer, makeKey("RSSo", i), stats[i].on_time);
+	}
+
+	setParameter(buffer, "RSWn", getMinOnTime());
+	setParameter(buffer, "RSWf", getMinOffTime());
+	setParameter(buffer, "RSWr", getMaxSwitches());
 }
 
 void RelayManager::readSettings(char* buffer) {
-	getParameter(buffer, "RSif", &invert_flag);
-	getParameter(buffer, "RSm", &mode);
+	getParameter(buffer, "RSWn", &min_on_time);
+	getParameter(buffer, "RSWf", &min_off_time);
+	getParameter(buffer, "RSWr", &max_switches);
+
+	setMinOnTime(min_on_time);
+	setMinOffTime(min_off_time);
+	setMaxSwitches(max_switches);
+
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		float kp = getPidKp(i);
+		float ki = getPidKi(i);
+		float kd = getPidKd(i);
+
+		getParameter(buffer, makeKey("RSif", i), &invert_flag[i]);
+		getParameter(buffer, makeKey("RSm", i), &mode[i]);
+
+		getParameter(buffer, makeKey("RSTsi", i), &therm_sensor_index[i]);
+		getParameter(buffer, makeKey("RSTst", i), &therm_set_t[i]);
+		getParameter(buffer, makeKey("RSTd", i), &therm_delta[i]);
+		getParameter(buffer, makeKey("RSTm", i), &therm_mode[i]);
+		getParameter(buffer, makeKey("RSTerf", i), &therm_error_relay_flag[i]);
 
-	getParameter(buffer, "RSTsi", &therm_sensor_index);
-	getParameter(buffer, "RSTst", &therm_set_t);
-	getParameter(buffer, "RSTd", &therm_delta);
-	getParameter(buffer, "RSTm", &therm_mode);
-	getParameter(buffer, "RSTerf", &therm_error_relay_flag);
+		getParameter(buffer, makeKey("RSPp", i), &kp);
+		getParameter(buffer, makeKey("RSPi", i), &ki);
+		getParameter(buffer, makeKey("RSPd", i), &kd);
+		getParameter(buffer, makeKey("RSPw", i), &pid_window[i]);
 
-	setInvertFlag(invert_flag);
-	setMode(mode);
+		getParameter(buffer, makeKey("RSHf", i), &schedule_flag[i]);
+		getParameter(buffer, makeKey("RSHn", i), &periods_count[i]);
 
-	setThermSensor(therm_sensor_index);
-	setThermSetT(therm_set_t);
-	setThermDelta(therm_delta);
-	setThermMode(therm_mode);
-	setThermErrorRelayFlag(therm_error_relay_flag);
+		periods_count[i] = min(periods_count[i], (uint8_t) RELAY_PERIODS_MAX);
+		if (periods_count[i] && !getParameter(buffer, makeKey("RSHp", i), (uint8_t*) periods[i], periods_count[i] * sizeof(relay_period_t))) {
+			periods_count[i] = 0;
+		}
+
+		getParameter(buffer, makeKey("RSSc", i), &stats[i].cycles);
+		getParameter(buffer, makeKey("RSSo", i), &stats[i].on_time);
+
+		setInvertFlag(i, invert_flag[i]);
+		setMode(i, mode[i]);
+
+		setThermSensor(i, therm_sensor_index[i]);
+		setThermSetT(i, therm_set_t[i]);
+		setThermDelta(i, therm_delta[i]);
+		setThermMode(i, therm_mode[i]);
+		setThermErrorRelayFlag(i, therm_error_relay_flag[i]);
+
+		setPidKp(i, kp);
+		setPidKi(i, ki);
+		setPidKd(i, kd);
+		setPidWindow(i, pid_window[i]);
+
+		// a damaged entry drops out rather than taking the whole schedule with it
+		uint8_t count = 0;
+		for (uint8_t j = 0;j < periods_count[i];j++) {
+			if (isCorrectPeriod(&periods[i][j])) {
+				periods[i][count++] = periods[i][j];
+			}
+		}
+		periods_count[i] = count;
+
+		setScheduleFlag(i, schedule_flag[i]);
+		compileSchedule(i);
+	}
 }
 
 void RelayManager::setSystemManager(SystemManager* system) {
 	this->system = system;
 }
 
-void RelayManager::setRelayFlag(bool relay_flag, bool sync_flag) {
-	if (getRelayFlag() != relay_flag || sync_flag) {Serial.print("set ");Serial.println(relay_flag);
-		this->relay_flag = relay_flag;
+void RelayManager::setRelayFlag(uint8_t channel, bool relay_flag, bool sync_flag) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	if (getRelayFlag(channel) != relay_flag || sync_flag) {
+		if (getRelayFlag(channel) != relay_flag) {
+			updateStats(channel);
+			switch_timer[channel] = millis();
 
-		relayTick();
-		notifyObservers(String("/relay/data/relay_flag"), &relay_flag, TYPE_BOOL);
+			if (relay_flag) {
+				stats[channel].cycles++;
+			}
+		}
+
+		this->relay_flag[channel] = relay_flag;
+
+		relayTick(channel);
+		notifyObservers(makeCode("/relay/data/relay_flag", channel), &relay_flag, TYPE_BOOL);
 	}
 }
 
 
-void RelayManager::setInvertFlag(bool invert_flag) {
-	this->invert_flag = invert_flag;
-	relayTick();
+void RelayManager::setInvertFlag(uint8_t channel, bool invert_flag) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	this->invert_flag[channel] = invert_flag;
+	relayTick(channel);
 }
 
-void RelayManager::setMode(uint8_t mode) {
-	this->mode = mode;
+void RelayManager::setMode(uint8_t channel, uint8_t mode) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	if (this->mode[channel] != mode) {
+		resetPid(channel);
+		pending_flag[channel] = false;
+	}
+
+	this->mode[channel] = mode;
+	thermTick(channel);
 }
 
 
-void RelayManager::setThermSensor(int8_t ds18b20_index) {
+void RelayManager::setThermSensor(uint8_t channel, int8_t ds18b20_index) {
 	SensorsManager* sensors = system->getSensorsManager();
-	this->therm_sensor_index = constrain(ds18b20_index, -1, sensors->getDS18B20Count() - 1);
+
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	this->therm_sensor_index[channel] = constrain(ds18b20_index, -1, sensors->getDS18B20Count() - 1);
+	thermTick(channel);
+}
+
+void RelayManager::setThermSetT(uint8_t channel, float t) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	this->therm_set_t[channel] = t;
+	updateTarget(channel);
+}
+
+void RelayManager::setThermDelta(uint8_t channel, float delta) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	this->therm_delta[channel] = delta;
+	thermTick(channel);
+}
+
+void RelayManager::setThermMode(uint8_t channel, uint8_t mode) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	this->therm_mode[channel] = mode;
+	thermTick(channel);
+}
+
+void RelayManager::setThermErrorRelayFlag(uint8_t channel, bool relay_flag) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	this->therm_error_relay_flag[channel] = relay_flag;
+	thermTick(channel);
+}
+
+
+void RelayManager::setPidKp(uint8_t channel, float kp) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	this->pid_kp[channel] = constrain(kp, 0, 10000) * RELAY_PID_GAIN_SCALE;
+	thermTick(channel);
 }
 
-void RelayManager::setThermSetT(float t) {
-	this->therm_set_t = t;
+void RelayManager::setPidKi(uint8_t channel, float ki) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	this->pid_ki[channel] = constrain(ki, 0, 10000) * RELAY_PID_GAIN_SCALE;
+	thermTick(channel);
 }
 
-void RelayManager::setThermDelta(float delta) {
-	this->therm_delta = delta;
+void RelayManager::setPidKd(uint8_t channel, float kd) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	this->pid_kd[channel] = constrain(kd, 0, 10000) * RELAY_PID_GAIN_SCALE;
+	thermTick(channel);
 }
 
-void RelayManager::setThermMode(uint8_t mode) {
-	this->therm_mode = mode;
+void RelayManager::setPidWindow(uint8_t channel, uint16_t window) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	this->pid_window[channel] = constrain(window, RELAY_PID_WINDOW_MIN, RELAY_PID_WINDOW_MAX);
 }
 
-void RelayManager::setThermErrorRelayFlag(bool relay_flag) {
-	this->therm_error_relay_flag = relay_flag;
+
+void RelayManager::setScheduleFlag(uint8_t channel, bool schedule_flag) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	this->schedule_flag[channel] = schedule_flag;
+	syncSchedule(channel, SystemManager::getClockTime());
+}
+
+void RelayManager::setSchedule(uint8_t channel, String* schedule) {
+	setSchedule(channel, (schedule != NULL) ? schedule->c_str() : NULL);
+}
+void RelayManager::setSchedule(uint8_t channel, const char* schedule) {
+	if (!isCorrectChannel(channel) || schedule == NULL) {
+		return;
+	}
+
+	// "<days>@HH:MM=T" separated by spaces or ';', days 1 - Monday ... 7 - Sunday, '*' - every day
+	relay_period_t parsed[RELAY_PERIODS_MAX];
+	uint8_t count = 0;
+
+	while (*schedule) {
+		if (*schedule == ' ' || *schedule == ';') {
+			schedule++;
+			continue;
+		}
+
+		if (count >= RELAY_PERIODS_MAX) {
+			return;
+		}
+
+		uint16_t length = strcspn(schedule, " ;");
+		const char* at = (const char*) memchr(schedule, '@', length);
+		const char* colon = (const char*) memchr(schedule, ':', length);
+		const char* equal = (const char*) memchr(schedule, '=', length);
+		relay_period_t* period = &parsed[count];
+		int32_t hour, minute, t;
+
+		if (at == NULL || colon == NULL || equal == NULL || !(at < colon && colon < equal)) {
+			return;
+		}
+
+		period->days = 0;
+		for (const char* day = schedule;day < at;day++) {
+			if (*day == '*') {
+				period->days = 0x7F;
+			}
+			else if (*day >= '1' && *day <= '7') {
+				period->days |= 1 << (*day - '1');
+			}
+			else {
+				return;
+			}
+		}
+
+		if (!parseInt(at + 1, colon - at - 1, &hour) || !parseInt(colon + 1, equal - colon - 1, &minute) || hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+			return;
+		}
+		if (!parseFixed(equal + 1, schedule + length - equal - 1, &t, RELAY_SCHEDULE_DECIMALS) || t < INT16_MIN || t > INT16_MAX) {
+			return;
+		}
+
+		period->start = hour * 60 + minute;
+		period->t = t;
+
+		if (!isCorrectPeriod(period)) {
+			return;
+		}
+
+		count++;
+		schedule += length;
+	}
+
+	memcpy(periods[channel], parsed, count * sizeof(relay_period_t));
+	periods_count[channel] = count;
+
+	compileSchedule(channel);
+}
+
+void RelayManager::setOverride(uint8_t channel, float t, uint16_t time) {
+	if (!isCorrectChannel(channel)) {
+		return;
+	}
+
+	override_flag[channel] = true;
+	override_t[channel] = t;
+	override_time[channel] = min(time, (uint16_t) RELAY_WEEK_MINUTES);
+	override_timer[channel] = millis();
+
+	updateTarget(channel);
+}
+
+void RelayManager::cancelOverride(uint8_t channel) {
+	if (!isCorrectChannel(channel) || !override_flag[channel]) {
+		return;
+	}
+
+	override_flag[channel] = false;
+	updateTarget(channel);
+}
+
+void RelayManager::syncSchedule() {
+	time_t now = SystemManager::getClockTime();
+
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		syncSchedule(i, now);
+	}
+}
+
+
+void RelayManager::setMinOnTime(uint16_t time) {
+	this->min_on_time = time;
+}
+
+void RelayManager::setMinOffTime(uint16_t time) {
+	this->min_off_time = time;
+}
+
+void RelayManager::setMaxSwitches(uint16_t count) {
+	this->max_switches = count;
+
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		switch_tokens[i] = min(switch_tokens[i], (uint32_t) count * 1000);
+	}
+}
+
+
+bool RelayManager::getRelayFlag(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return false;
+	}
+
+	return relay_flag[channel];
+}
+
+relay_stats_t* RelayManager::getStats(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return NULL;
+	}
+
+	updateStats(channel);
+	return &stats[channel];
+}
+
+const char* RelayManager::getFlagCode(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return "";
+	}
+
+	return flag_codes[channel];
 }
 
+float RelayManager::getTargetT(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return 0;
+	}
+
+	// an override beats the schedule, the schedule beats the fixed setpoint
+	if (override_flag[channel]) {
+		return override_t[channel];
+	}
+	if (schedule_status[channel]) {
+		return (float) schedule_t[channel] / RELAY_PID_T_SCALE;
+	}
 
-bool RelayManager::getRelayFlag() {
-	return relay_flag;
+	return therm_set_t[channel];
 }
 
 
-bool RelayManager::getInvertFlag() {
-	return invert_flag;
+bool RelayManager::getInvertFlag(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return false;
+	}
+
+	return invert_flag[channel];
 }
 
-uint8_t RelayManager::getMode() {
-	return mode;
+uint8_t RelayManager::getMode(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return RELAY_MODE_SIMPLE;
+	}
+
+	return mode[channel];
 }
 
 
-uint8_t RelayManager::getThermStatus() {
+uint8_t RelayManager::getThermStatus(uint8_t channel) {
 	SensorsManager* sensors = system->getSensorsManager();
 
-	if (getThermSensor() >= sensors->getDS18B20Count() || getThermSensor() < 0) return 1;
-	if (sensors->getDS18B20Status(getThermSensor()) ) return 2;
+	if (getThermSensor(channel) >= sensors->getDS18B20Count() || getThermSensor(channel) < 0) return 1;
+	if (sensors->getDS18B20Status(getThermSensor(channel)) ) return 2;
 
 	return 0;
 }
 
-float RelayManager::getThermT() {
+float RelayManager::getThermT(uint8_t channel) {
 	SensorsManager* sensors = system->getSensorsManager();
-	return sensors->getDS18B20T(getThermSensor());
+	return sensors->getDS18B20T(getThermSensor(channel));
+}
+
+int8_t RelayManager::getThermSensor(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return -1;
+	}
+
+	return therm_sensor_index[channel];
+}
+
+float RelayManager::getThermSetT(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return 0;
+	}
+
+	return therm_set_t[channel];
+}
+
+float RelayManager::getThermDelta(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return 0;
+	}
+
+	return therm_delta[channel];
+}
+
+uint8_t RelayManager::getThermMode(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return 0;
+	}
+
+	return therm_mode[channel];
+}
+
+bool RelayManager::getThermErrorRelayFlag(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return false;
+	}
+
+	return therm_error_relay_flag[channel];
 }
 
-int8_t RelayManager::getThermSensor() {
-	return therm_sensor_index;
+
+float RelayManager::getPidKp(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return 0;
+	}
+
+	return (float) pid_kp[channel] / RELAY_PID_GAIN_SCALE;
 }
 
-float RelayManager::getThermSetT() {
-	return therm_set_t;
+float RelayManager::getPidKi(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return 0;
+	}
+
+	return (float) pid_ki[channel] / RELAY_PID_GAIN_SCALE;
 }
 
-float RelayManager::getThermDelta() {
-	return therm_delta;
+float RelayManager::getPidKd(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return 0;
+	}
+
+	return (float) pid_kd[channel] / RELAY_PID_GAIN_SCALE;
 }
 
-uint8_t RelayManager::getThermMode() {
-	return therm_mode;
+uint16_t RelayManager::getPidWindow(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return 0;
+	}
+
+	return pid_window[channel];
 }
 
-bool RelayManager::getThermErrorRelayFlag() {
-	return therm_error_relay_flag;
+uint16_t RelayManager::getPidDuty(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return 0;
+	}
+
+	return pid_duty[channel];
+}
+
+
+bool RelayManager::getScheduleFlag(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return false;
+	}
+
+	return schedule_flag[channel];
+}
+
+uint16_t RelayManager::printSchedule(uint8_t channel, char* buffer, uint16_t size) {
+	if (!isCorrectChannel(channel) || buffer == NULL || !size) {
+		return 0;
+	}
+
+	int length = 0;
+	buffer[0] = 0;
+
+	// the same text setSchedule() takes
+	for (uint8_t i = 0;i < periods_count[channel] && length < size;i++) {
+		relay_period_t* period = &periods[channel][i];
+
+		if (i) {
+			length += snprintf(buffer + length, size - length, " ");
+		}
+
+		if (period->days == 0x7F) {
+			length += snprintf(buffer + length, size - length, "*");
+		}
+		else {
+			for (uint8_t day = 0;day < 7 && length < size;day++) {
+				if (period->days & (1 << day)) {
+					length += snprintf(buffer + length, size - length, "%u", day + 1);
+				}
+			}
+		}
+
+		if (length < size) {
+			length += snprintf(buffer + length, size - length, "@%02u:%02u=", period->start / 60, period->start % 60);
+		}
+		if (length < size) {
+			length += formatFixed(buffer + length, size - length, period->t, RELAY_SCHEDULE_DECIMALS);
+		}
+	}
+
+	return (length < size) ? length : size - 1;
+}
+
+uint8_t RelayManager::getPeriodsCount(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return 0;
+	}
+
+	return periods_count[channel];
+}
+
+bool RelayManager::getScheduleStatus(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return false;
+	}
+
+	return schedule_status[channel];
+}
+
+bool RelayManager::getOverrideFlag(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return false;
+	}
+
+	return override_flag[channel];
+}
+
+float RelayManager::getOverrideT(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return 0;
+	}
+
+	return override_t[channel];
+}
+
+uint16_t RelayManager::getOverrideTime(uint8_t channel) {
+	if (!isCorrectChannel(channel)) {
+		return 0;
+	}
+
+	return override_time[channel];
+}
+
+
+uint16_t RelayManager::getMinOnTime() {
+	return min_on_time;
+}
+
+uint16_t RelayManager::getMinOffTime() {
+	return min_off_time;
+}
+
+uint16_t RelayManager::getMaxSwitches() {
+	return max_switches;
 }
 
 
@@ -241,6 +1183,40 @@ void RelayManager::notifyObservers(String code, void* data, uint8_t type) {
 	}
 }
 
-void RelayManager::relayTick() {//Serial.println(getRelayFlag());
-	digitalWrite(RELAY_PORT, getInvertFlag() ? !getRelayFlag() : getRelayFlag());
-}
\ No newline at end of file
+void RelayManager::relayTick(uint8_t channel) {
+	uint8_t level = getInvertFlag(channel) ? !getRelayFlag(channel) : getRelayFlag(channel);
+
+	if (level == output_level[channel]) {
+		return;
+	}
+
+	output_level[channel] = level;
+	digitalWrite(relay_ports[channel], level);
+}
+
+
+bool RelayManager::isCorrectChannel(uint8_t channel) {
+	if (channel >= RELAY_CHANNELS_COUNT) {
+		return false;
+	}
+
+	return true;
+}
+
+bool RelayManager::isCorrectPeriod(relay_period_t* period) {
+	if (!period->days || period->days > 0x7F || period->start >= RELAY_DAY_MINUTES) {
+		return false;
+	}
+
+	return true;
+}
+
+String RelayManager::makeCode(const char* code, uint8_t channel) {
+	// the first channel keeps the single relay codes, so existing topics and Blynk links still match
+	return (channel) ? String(code) + "/" + channel : String(code);
+}
+
+String RelayManager::makeKey(const char* key, uint8_t channel) {
+	// same for settings keys, an old config file loads into the first channel
+	return (channel) ? String(key) + channel : String(key);
+}
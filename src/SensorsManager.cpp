@@ -135,6 +135,9 @@ void SensorsManager::updateSensorsData() {
 		system->setSensorsReadFlag(true);
 		notifyObservers(String("/sensors/data/ds18b20/temp/") + getDS18B20Name(i), &ds18b20_data[i].t, TYPE_FLOAT);
 	}
+
+	uint8_t ds18b20_count = getDS18B20Count();
+	notifyObservers(String("/sensors/data/updated"), &ds18b20_count, TYPE_UINT8_T);
 }
 
 
@@ -9,6 +9,8 @@
 
 #include "data.h"
 
+volatile bool SystemManager::clock_sync_flag = false;
+
 SystemManager::SystemManager() {
 	makeDefault();
 }
@@ -17,6 +19,7 @@ SystemManager::SystemManager() {
 void SystemManager::makeDefault() {
 	setSleepFlag(DEFAULT_SLEEP_STATUS);
 	setSleepTime(DEFAULT_SLEEP_TIME);
+	setTimeZone(DEFAULT_TIME_ZONE);
 
 	observers.clear();
 	sleep_reqs.makeDefault();
@@ -24,12 +27,20 @@ void SystemManager::makeDefault() {
 	save_settings_request = false;
 	save_settings_timer = 0;
 	work_timer = 0;
+	diagnostics_publish_timer = 0;
+#if PROFILER_ENABLED
+	profiler.makeDefault();
+#endif
 }
 
 void SystemManager::begin() {
 	Serial.begin(9600);
 	LittleFS.begin();
 
+#if FORMAT_BENCHMARK_ENABLED
+	benchmarkFormat();
+#endif
+
 	/* SystemManager */
 	addObserver(&mqtt);
 	/* SystemManager */
@@ -38,6 +49,7 @@ void SystemManager::begin() {
 	sensors.setSystemManager(this);
 	sensors.addObserver(&mqtt);
 	sensors.addObserver(&blynk);
+	sensors.addObserver(&relay);
 	/* SensorsManager */
 
 	/* RelayManager */
@@ -48,21 +60,28 @@ void SystemManager::begin() {
 
 	/* NetworkManager */
 	network.setSystemManager(this);
+	network.addObserver(&mqtt);
+	network.addObserver(&blynk);
 	/* NetworkManager */
 
 	/* BlynkManager */
 	blynk.setSystemManager(this);
-	blynk.addObserver(this);
-	blynk.addObserver(&relay);
+	blynk.addRoute("/system/settings/reset", this, TYPE_BOOL);
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		blynk.addRoute(relay.getFlagCode(i), &relay, TYPE_BOOL);
+	}
 	/* BlynkManager */
 
 	/* MqttManager */
 	mqtt.setSystemManager(this);
-	mqtt.addObserver(this);
-	mqtt.addObserver(&sensors);
-	mqtt.addObserver(&relay);
+	mqtt.addRoute("/system/settings/reset", this, TYPE_BOOL);
+	for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+		mqtt.addRoute(relay.getFlagCode(i), &relay, TYPE_BOOL);
+	}
 	/* MqttManager */
 
+	settimeofday_cb(clockSynced);
+
 	readSettings();
 	
 	pinMode(BUTTON_PORT, INPUT_PULLUP);
@@ -81,7 +100,10 @@ void SystemManager::begin() {
 }
 
 void SystemManager::tick() {
-	// uint32_t tick = millis();
+#if PROFILER_ENABLED
+	uint32_t loop_cycles = ESP.getCycleCount();
+#endif
+
 	if (getSleepFlag()) {
 		if (!work_timer) {
 			work_timer = millis();
@@ -89,30 +111,46 @@ void SystemManager::tick() {
 
 		else if (millis() - work_timer > SEC_TO_MLS(WORK_TIME)) {
 			Serial.println("timeout sleep");
-			ESP.deepSleep(MIN_TO_MLS(getSleepTime()) * 1000);
+			sleep();
 		}
 	}
 
-	sensors.tick();
+	// SNTP runs in the background once configured, the schedule follows every clock step
+	if (clock_config_request) {
+		configTime(getTimeZone(), DEFAULT_NTP_SERVER);
+		clock_config_request = false;
+
+		relay.syncSchedule();
+	}
+	if (clock_sync_flag) {
+		clock_sync_flag = false;
+		relay.syncSchedule();
+	}
+
+	PROFILE(&profiler, PROFILER_SENSORS, sensors.tick());
 
 	if (!getSleepFlag()) {
-		relay.tick();
+		PROFILE(&profiler, PROFILER_RELAY, relay.tick());
 	}
 
-	network.tick();
-	mqtt.tick();
-	blynk.tick();
+	PROFILE(&profiler, PROFILER_NETWORK, network.tick());
+	PROFILE(&profiler, PROFILER_MQTT, mqtt.tick());
+	PROFILE(&profiler, PROFILER_BLYNK, blynk.tick());
 
 	saveSettings();
+	publishDiagnostics();
 
 	if (getSleepFlag()) {
 		if (sleep_reqs.isReqsDone()) {
 			Serial.println("reqsDone sleep");
 
-			ESP.deepSleep(MIN_TO_MLS(getSleepTime()) * 1000);
+			sleep();
 		}
 	}
-	// Serial.println(millis() - tick);
+
+#if PROFILER_ENABLED
+	profiler.addSample(PROFILER_LOOP, (ESP.getCycleCount() - loop_cycles) / ESP.getCpuFreqMHz());
+#endif
 }
 
 void SystemManager::addElementCodes(DynamicArray<String>* array) {
@@ -143,6 +181,8 @@ bool SystemManager::handleEvent(const char* code, void* data, uint8_t type) {
 
 
 void SystemManager::reset() {
+	mqtt.saveQueue();
+	relay.writeStatsCache();
 	ESP.reset();
 }
 
@@ -202,6 +242,18 @@ void SystemManager::setSleepTime(uint8_t sleep_time) {
 	this->sleep_time = sleep_time;
 }
 
+void SystemManager::setTimeZone(String* tz) {
+	setTimeZone((tz != NULL) ? tz->c_str() : NULL);
+}
+void SystemManager::setTimeZone(const char* tz) {
+	if (tz == NULL || !strlen(tz)) {
+		return;
+	}
+
+	strlcpy(this->tz, tz, SYSTEM_TZ_SIZE);
+	clock_config_request = true;
+}
+
 
 void SystemManager::setSensorsReadFlag(bool flag) {
 	sleep_reqs.sensors_read_flag = flag;
@@ -240,6 +292,12 @@ BlynkManager* SystemManager::getBlynkManager() {
 	return &blynk;
 }
 
+#if PROFILER_ENABLED
+Profiler* SystemManager::getProfiler() {
+	return &profiler;
+}
+#endif
+
 
 bool SystemManager::getSleepFlag() {
 	return sleep_flag;
@@ -249,6 +307,15 @@ uint8_t SystemManager::getSleepTime() {
 	return sleep_time;
 }
 
+const char* SystemManager::getTimeZone() {
+	return tz;
+}
+
+time_t SystemManager::getClockTime() {
+	time_t now = time(NULL);
+	return (now >= CLOCK_VALID_TIME) ? now : 0;
+}
+
 
 bool SystemManager::getSensorsReadFlag() {
 	return sleep_reqs.sensors_read_flag;
@@ -283,10 +350,13 @@ void SystemManager::saveSettings(bool ignore_flag) {
 	Serial.println("save");
 
 	File file = LittleFS.open("/config.nztr", "w");
-	char buffer[SETTINGS_BUFFER_SIZE + 1] = "";
+	// as large as the loop stack, keep it on the heap
+	char* buffer = new char[SETTINGS_BUFFER_SIZE + 1];
+	buffer[0] = 0;
 
 	setParameter(buffer, "SSsf", getSleepFlag());
 	setParameter(buffer, "SSst", getSleepTime());
+	setParameter(buffer, "SStz", (const char*) getTimeZone());
 
 	sensors.writeSettings(buffer);
 	relay.writeSettings(buffer);
@@ -296,6 +366,7 @@ void SystemManager::saveSettings(bool ignore_flag) {
 
 	file.write(buffer, strlen(buffer));
   	file.close();
+	delete[] buffer;
 
 	save_settings_request = false;
 	save_settings_timer = millis();
@@ -317,9 +388,11 @@ void SystemManager::readSettings() {
 	
 	getParameter(buffer, "SSsf", &sleep_flag);
 	getParameter(buffer, "SSst", &sleep_time);
+	getParameter(buffer, "SStz", tz, SYSTEM_TZ_SIZE);
 
 	setSleepFlag(sleep_flag);
 	setSleepTime(sleep_time);
+	setTimeZone(tz);
 	
 	sensors.readSettings(buffer);
 	relay.readSettings(buffer);
@@ -331,6 +404,52 @@ void SystemManager::readSettings() {
 	file.close();
 }
 
+void SystemManager::publishDiagnostics() {
+	char buffer[DIAGNOSTICS_PAYLOAD_SIZE];
+
+	if (getSleepFlag()) {
+		return;
+	}
+
+	if (diagnostics_publish_timer && millis() - diagnostics_publish_timer < SEC_TO_MLS(DIAGNOSTICS_PUBLISH_TIME)) {
+		return;
+	}
+	diagnostics_publish_timer = millis();
+
+#if PROFILER_ENABLED
+	for (uint8_t i = 0;i < PROFILER_SLOTS_COUNT;i++) {
+		profiler.printSlot(i, buffer, DIAGNOSTICS_PAYLOAD_SIZE);
+		notifyObservers(String("/system/data/profiler/") + profiler.getSlotName(i), buffer, TYPE_STRING);
+	}
+#endif
+
+	network.getReconnectPolicy()->print(buffer, DIAGNOSTICS_PAYLOAD_SIZE);
+	notifyObservers(String("/system/data/reconnect/network"), buffer, TYPE_STRING);
+
+	mqtt.getReconnectPolicy()->print(buffer, DIAGNOSTICS_PAYLOAD_SIZE);
+	notifyObservers(String("/system/data/reconnect/mqtt"), buffer, TYPE_STRING);
+
+	blynk.getReconnectPolicy()->print(buffer, DIAGNOSTICS_PAYLOAD_SIZE);
+	notifyObservers(String("/system/data/reconnect/blynk"), buffer, TYPE_STRING);
+
+	mqtt.printStats(buffer, DIAGNOSTICS_PAYLOAD_SIZE);
+	notifyObservers(String("/system/data/mqtt"), buffer, TYPE_STRING);
+
+	blynk.printStats(buffer, DIAGNOSTICS_PAYLOAD_SIZE);
+	notifyObservers(String("/system/data/blynk"), buffer, TYPE_STRING);
+}
+
+void SystemManager::sleep() {
+	// unsent readings survive the deep sleep reset on LittleFS
+	mqtt.saveQueue();
+	relay.writeStatsCache(MIN_TO_MLS(getSleepTime()));
+	ESP.deepSleep(MIN_TO_MLS(getSleepTime()) * 1000);
+}
+
+void SystemManager::clockSynced() {
+	clock_sync_flag = true;
+}
+
 bool SystemManager::getButtonStatus() {
 	return !digitalRead(BUTTON_PORT);
 }
\ No newline at end of file
@@ -0,0 +1,351 @@
+/*
+ * Project: Temperature Tick
+ *
+ * Author: Vereshchynskyi Nazar
+ * Email: verechnazar12@gmail.com
+ * Version: 1.0.0
+ * Date: 02.03.2025
+ */
+
+#include "data.h"
+
+uint32_t calcCrc32(const void* data, uint16_t length) {
+	const uint8_t* bytes = (const uint8_t*) data;
+	uint32_t crc = 0xFFFFFFFF;
+
+	for (uint16_t i = 0;i < length;i++) {
+		crc ^= bytes[i];
+
+		for (uint8_t j = 0;j < 8;j++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+
+	return ~crc;
+}
+
+uint32_t calcHash(const char* str) {
+	uint32_t hash = 2166136261UL; // FNV-1a
+
+	while (*str) {
+		hash = (hash ^ (uint8_t) *str++) * 16777619UL;
+	}
+
+	return hash;
+}
+
+static bool isParseEnd(const char* str, uint16_t i, uint16_t length) {
+	// after the number only spaces may follow, "12abc" or "0x10" is not 12 or 0
+	for (;i < length && str[i];i++) {
+		if (str[i] != ' ') {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool parseInt(const char* str, uint16_t length, int32_t* value) {
+	if (str == NULL || value == NULL) {
+		return false;
+	}
+
+	uint16_t i = 0;
+	bool negative = false;
+	int32_t result = 0;
+
+	while (i < length && str[i] == ' ') {
+		i++;
+	}
+
+	if (i < length && (str[i] == '-' || str[i] == '+')) {
+		negative = (str[i++] == '-');
+	}
+
+	if (i >= length || str[i] < '0' || str[i] > '9') {
+		return false;
+	}
+
+	for (;i < length && str[i] >= '0' && str[i] <= '9';i++) {
+		// past INT32_MAX the value is rejected rather than wrapped
+		if (result > (INT32_MAX - (str[i] - '0')) / 10) {
+			return false;
+		}
+
+		result = result * 10 + (str[i] - '0');
+	}
+
+	if (!isParseEnd(str, i, length)) {
+		return false;
+	}
+
+	*value = (negative) ? -result : result;
+	return true;
+}
+
+bool parseBool(const char* str, uint16_t length, bool* value) {
+	if (str == NULL || value == NULL || !length) {
+		return false;
+	}
+
+	if ((length == 4 && !strncasecmp(str, "true", 4)) || (length == 2 && !strncasecmp(str, "on", 2))) {
+		*value = true;
+		return true;
+	}
+	if ((length == 5 && !strncasecmp(str, "false", 5)) || (length == 3 && !strncasecmp(str, "off", 3))) {
+		*value = false;
+		return true;
+	}
+
+	int32_t number;
+	if (!parseInt(str, length, &number)) {
+		return false;
+	}
+
+	*value = number;
+	return true;
+}
+
+bool parseFixed(const char* str, uint16_t length, int32_t* value, uint8_t decimals) {
+	if (str == NULL || value == NULL) {
+		return false;
+	}
+
+	uint16_t i = 0;
+	bool negative = false;
+	bool digits = false;
+	int32_t result = 0;
+
+	while (i < length && str[i] == ' ') {
+		i++;
+	}
+
+	if (i < length && (str[i] == '-' || str[i] == '+')) {
+		negative = (str[i++] == '-');
+	}
+
+	// the scaled value must fit, so the whole part is bounded by INT32_MAX / 10^decimals
+	for (;i < length && str[i] >= '0' && str[i] <= '9';i++) {
+		if (result > (INT32_MAX - (str[i] - '0')) / 10) {
+			return false;
+		}
+
+		result = result * 10 + (str[i] - '0');
+		digits = true;
+	}
+
+	if (i < length && (str[i] == '.' || str[i] == ',')) {
+		i++;
+	}
+
+	// missing fractional digits are padded with zeros
+	for (uint8_t j = 0;j < decimals;j++) {
+		uint8_t digit = (i < length && str[i] >= '0' && str[i] <= '9') ? str[i] - '0' : 0;
+
+		if (result > (INT32_MAX - digit) / 10) {
+			return false;
+		}
+		result = result * 10 + digit;
+
+		if (i < length && str[i] >= '0' && str[i] <= '9') {
+			i++;
+			digits = true;
+		}
+	}
+
+	// digits past the precision can only be zeros, anything else would be lost
+	while (i < length && str[i] == '0') {
+		i++;
+	}
+
+	if (!digits || !isParseEnd(str, i, length)) {
+		return false;
+	}
+
+	*value = (negative) ? -result : result;
+	return true;
+}
+
+uint8_t formatUint(char* buffer, uint8_t size, uint32_t value) {
+	char digits[10];
+	uint8_t count = 0;
+
+	if (buffer == NULL || !size) {
+		return 0;
+	}
+
+	do {
+		digits[count++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	if (count >= size) {
+		buffer[0] = 0;
+		return 0;
+	}
+
+	for (uint8_t i = 0;i < count;i++) {
+		buffer[i] = digits[count - 1 - i];
+	}
+	buffer[count] = 0;
+
+	return count;
+}
+
+uint8_t formatInt(char* buffer, uint8_t size, int32_t value) {
+	if (value >= 0) {
+		return formatUint(buffer, size, value);
+	}
+
+	if (buffer == NULL || size < 2) {
+		return 0;
+	}
+
+	buffer[0] = '-';
+	uint8_t length = formatUint(buffer + 1, size - 1, 0U - (uint32_t) value);
+
+	if (!length) {
+		buffer[0] = 0;
+		return 0;
+	}
+
+	return length + 1;
+}
+
+uint8_t formatFixed(char* buffer, uint8_t size, int32_t value, uint8_t decimals) {
+	static const uint32_t scales[FORMAT_DECIMALS_MAX + 1] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+	if (!decimals) {
+		return formatInt(buffer, size, value);
+	}
+	if (buffer == NULL || !size) {
+		return 0;
+	}
+
+	decimals = min(decimals, (uint8_t) FORMAT_DECIMALS_MAX);
+
+	uint32_t magnitude = (value < 0) ? 0U - (uint32_t) value : value;
+	uint32_t fraction = magnitude % scales[decimals];
+	uint8_t length = 0;
+
+	if (value < 0) {
+		if (size < 2) {
+			buffer[0] = 0;
+			return 0;
+		}
+
+		buffer[length++] = '-';
+	}
+
+	uint8_t integer_length = formatUint(buffer + length, size - length, magnitude / scales[decimals]);
+	length += integer_length;
+
+	if (!integer_length || length + 1 + decimals >= size) {
+		buffer[0] = 0;
+		return 0;
+	}
+
+	buffer[length++] = '.';
+
+	for (uint8_t i = decimals;i > 0;i--) {
+		buffer[length + i - 1] = '0' + fraction % 10;
+		fraction /= 10;
+	}
+
+	length += decimals;
+	buffer[length] = 0;
+
+	return length;
+}
+
+uint8_t formatFloat(char* buffer, uint8_t size, float value, uint8_t decimals) {
+	static const float scales[FORMAT_DECIMALS_MAX + 1] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+	decimals = min(decimals, (uint8_t) FORMAT_DECIMALS_MAX);
+
+	// one multiply and one conversion instead of dtostrf, the rest is integer work
+	float scaled = value * scales[decimals];
+
+	if (isnan(scaled) || scaled >= 2147483647.0f || scaled <= -2147483647.0f) {
+		if (buffer != NULL && size) {
+			buffer[0] = 0;
+		}
+
+		return 0;
+	}
+
+	return formatFixed(buffer, size, (int32_t) (scaled + ((scaled < 0) ? -0.5f : 0.5f)), decimals);
+}
+
+uint8_t formatValue(char* buffer, uint8_t size, void* data, uint8_t type, uint8_t decimals) {
+	if (data == NULL) {
+		return 0;
+	}
+
+	if (type == TYPE_BOOL)     return formatUint(buffer, size, *(bool*) data);
+	if (type == TYPE_UINT8_T)  return formatUint(buffer, size, *(uint8_t*) data);
+	if (type == TYPE_INT8_T)   return formatInt(buffer, size, *(int8_t*) data);
+	if (type == TYPE_UINT16_T) return formatUint(buffer, size, *(uint16_t*) data);
+	if (type == TYPE_INT16_T)  return formatInt(buffer, size, *(int16_t*) data);
+	if (type == TYPE_UINT32_T) return formatUint(buffer, size, *(uint32_t*) data);
+	if (type == TYPE_INT32_T)  return formatInt(buffer, size, *(int32_t*) data);
+	if (type == TYPE_FLOAT)    return formatFloat(buffer, size, *(float*) data, decimals);
+
+	if (type == TYPE_STRING && buffer != NULL && size) {
+		uint16_t length = strlcpy(buffer, (const char*) data, size);
+		return (length < size) ? length : 0;
+	}
+
+	return 0;
+}
+
+#if FORMAT_BENCHMARK_ENABLED
+void benchmarkFormat() {
+	char buffer[FORMAT_BUFFER_SIZE];
+	uint32_t heap = ESP.getFreeHeap();
+	uint32_t results[5];
+	uint32_t cycles;
+	float value;
+
+	value = -40.0f;
+	cycles = ESP.getCycleCount();
+	for (uint16_t i = 0;i < FORMAT_BENCHMARK_ROUNDS;i++, value += 0.37f) {
+		String string(value);
+		buffer[0] = string[0];
+	}
+	results[0] = (ESP.getCycleCount() - cycles) / FORMAT_BENCHMARK_ROUNDS;
+
+	value = -40.0f;
+	cycles = ESP.getCycleCount();
+	for (uint16_t i = 0;i < FORMAT_BENCHMARK_ROUNDS;i++, value += 0.37f) {
+		String string(value, 1);
+		buffer[0] = string[0];
+	}
+	results[1] = (ESP.getCycleCount() - cycles) / FORMAT_BENCHMARK_ROUNDS;
+
+	value = -40.0f;
+	cycles = ESP.getCycleCount();
+	for (uint16_t i = 0;i < FORMAT_BENCHMARK_ROUNDS;i++, value += 0.37f) {
+		formatFloat(buffer, FORMAT_BUFFER_SIZE, value, 2);
+	}
+	results[2] = (ESP.getCycleCount() - cycles) / FORMAT_BENCHMARK_ROUNDS;
+
+	cycles = ESP.getCycleCount();
+	for (uint16_t i = 0;i < FORMAT_BENCHMARK_ROUNDS;i++) {
+		String string((int32_t) i * 37 - 5000);
+		buffer[0] = string[0];
+	}
+	results[3] = (ESP.getCycleCount() - cycles) / FORMAT_BENCHMARK_ROUNDS;
+
+	cycles = ESP.getCycleCount();
+	for (uint16_t i = 0;i < FORMAT_BENCHMARK_ROUNDS;i++) {
+		formatInt(buffer, FORMAT_BUFFER_SIZE, (int32_t) i * 37 - 5000);
+	}
+	results[4] = (ESP.getCycleCount() - cycles) / FORMAT_BENCHMARK_ROUNDS;
+
+	Serial.println("format benchmark, cycles per call:");
+	Serial.printf("String(float) %u, String(float, 1) %u, formatFloat %u\n", results[0], results[1], results[2]);
+	Serial.printf("String(int) %u, formatInt %u\n", results[3], results[4]);
+	Serial.printf("heap before %u, after %u\n", heap, ESP.getFreeHeap());
+}
+#endif
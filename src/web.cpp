@@ -10,13 +10,12 @@
 #include "data.h"
 
 void Web::init() {
-	update_codes += "_RSrf,RTDt,RTDst";
-	update_codes += "_NSm,_NSWs,_NSAs,_NSAp,";
-	update_codes += "_MSwf,_MSSs,_MSSp,_MSAs,_MSAp,";
+	update_codes += "_NSm,_NSAs,_NSAp,";
+	update_codes += "_MSwf,_MSaf,_MSpm,_MSp,_MStf,_MSf,_MSSs,_MSSp,_MSAs,_MSAp,";
 	update_codes += "_BSwf,_BSa,";
 	update_codes += "_SSrdt,";
-	update_codes += "_RSif,_RSm,_RSTsi,_RSTst,_RSTd,_RSTm,_RSTerf,";
-	update_codes += "_SSsf,_SSst,";
+	update_codes += "_RSWn,_RSWf,_RSWr,";
+	update_codes += "_SSsf,_SSst,_SStz,";
 
 	ui.setFS(&LittleFS);
 	ui.enableOTA();
@@ -48,6 +47,22 @@ void Web::init() {
 			update_codes += ",";
 		}
 
+		for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+			const char* relay_codes[] = {"_RSrf", "RTDt", "RTDst", "RTDd", "_RSif", "_RSm", "_RSTsi", "_RSTst", "_RSTd", "_RSTm", "_RSTerf", "_RSPp", "_RSPi", "_RSPd", "_RSPw", "_RSHf", "_RSHs", "RSOt", "RSOm"};
+
+			for (uint8_t j = 0;j < sizeof(relay_codes) / sizeof(relay_codes[0]);j++) {
+				update_codes += relay_codes[j];
+				update_codes += i;
+				update_codes += ",";
+			}
+		}
+
+		for (uint8_t i = 0;i < network->getWifiCount();i++) {
+			update_codes += "_NSWs";
+			update_codes += i;
+			update_codes += ",";
+		}
+
 		for (uint8_t i = 0;i < blynk->getLinksCount();i++) {
 			update_codes += "_BSLp";
 			update_codes += i;
@@ -63,9 +78,10 @@ void Web::init() {
 		GP.BUILD_BEGIN(550);
 		GP.THEME(GP_DARK);
 		GP.UPDATE(update_codes, ui.uri("/settings") ? SEC_TO_MLS(WEB_UPDATE_TIME) + 5 : SEC_TO_MLS(WEB_UPDATE_TIME));
+		GP.UPDATE_CLICK("_MSaf", "_MSaf,_MStf"); // TLS clears async and async is refused under TLS, show it at once
 	
 		GP.TITLE("nazotronic");
-		GP.NAV_TABS_LINKS("/,/settings,/memory", "Home,Settings,Memory", GP_ORANGE);
+		GP.NAV_TABS_LINKS("/,/settings,/memory,/diag", "Home,Settings,Memory,Diag", GP_ORANGE);
 		GP.HR();
 
 		if (ui.uri("/")) {
@@ -82,7 +98,7 @@ void Web::init() {
 						GP.LABEL(":");
 						
 						if (!sensors->getDS18B20Status(i)) {
-							GP.PLAIN(String(sensors->getDS18B20T(i), 1) + "°", String("SDDt") + i);
+							GP.PLAIN(formatT(sensors->getDS18B20T(i)), String("SDDt") + i);
 						}
 						else {
 							GP.PLAIN("err", String("SDDt") + i);
@@ -91,30 +107,39 @@ void Web::init() {
 				}
 			);
 
-			M_BLOCK(GP_THIN,
-				GP.LABEL("Relay");
-
-				M_BOX(GP_LEFT,
-					GP.LABEL("Relay:");
-					GP.SWITCH("_RSrf", relay->getRelayFlag());
-				);
+			for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+				M_BLOCK(GP_THIN,
+					GP.LABEL(String("Relay ") + (i + 1));
 
-				if (relay->getMode() == RELAY_MODE_THERM) {
 					M_BOX(GP_LEFT,
-						GP.LABEL("Thermostat:");
+						GP.LABEL("Relay:");
+						GP.SWITCH(String("_RSrf") + i, relay->getRelayFlag(i));
+					);
 
-						if (!relay->getThermStatus()) {
-							GP.PLAIN(String(relay->getThermT(), 1) + "°", "RTDt");
-						}
-						else {
-							GP.PLAIN("err", "RTDt");
-						}
+					if (relay->getMode(i) != RELAY_MODE_SIMPLE) {
+						M_BOX(GP_LEFT,
+							GP.LABEL("Thermostat:");
 
-						GP.PLAIN(" -> ");
-						GP.PLAIN(String(relay->getThermSetT(), 1) + "°", "RTDst");
-					);
-				}
-			);
+							if (!relay->getThermStatus(i)) {
+								GP.PLAIN(formatT(relay->getThermT(i)), String("RTDt") + i);
+							}
+							else {
+								GP.PLAIN("err", String("RTDt") + i);
+							}
+
+							GP.PLAIN(" -> ");
+							GP.PLAIN(formatT(relay->getTargetT(i)), String("RTDst") + i);
+						);
+					}
+
+					if (relay->getMode(i) == RELAY_MODE_PID) {
+						M_BOX(GP_LEFT,
+							GP.LABEL("Duty:");
+							GP.PLAIN(String(relay->getPidDuty(i) / 10) + "%", String("RTDd") + i);
+						);
+					}
+				);
+			}
 
 			GP.HR();
 			GP.SPAN("Temperature Tick", GP_LEFT);
@@ -130,14 +155,28 @@ void Web::init() {
 					GP.SELECT("_NSm", "off,sta,ap_sta,auto", network->getMode());
 				);
 				
-				M_FORM2("/_NSW",
-					M_BLOCK(GP_THIN,
-						GP.TITLE("WiFi");
-						GP.TEXT("_NSWs", "ssid", network->getWifiSsid(), "50%", NETWORK_SSID_PASS_SIZE);
-						GP.PASS_EYE("_NSWp", "pass", "", "", NETWORK_SSID_PASS_SIZE);
-						GP.BREAK();
-						GP.SUBMIT_MINI(" OK ", GP_ORANGE);
-					);
+				M_BLOCK(GP_THIN,
+					GP.TITLE("WiFi");
+
+					for (uint8_t i = 0;i < network->getWifiCount();i++) {
+						M_FORM2(String("/_NSW") + i,
+							M_BLOCK(GP_THIN,
+								int8_t rssi = network->getWifiRssi(i);
+
+								GP.TEXT(String("_NSWs") + i, "ssid", network->getWifiSsid(i), "50%", NETWORK_SSID_PASS_SIZE);
+								GP.PASS_EYE(String("_NSWp") + i, "pass", "", "", NETWORK_SSID_PASS_SIZE);
+								GP.BREAK();
+								GP.PLAIN((rssi != NETWORK_RSSI_NONE) ? String(rssi) + " dBm" : String("-"));
+								GP.PLAIN((network->getWifiIndex() == i) ? " connected" : "");
+								GP.BREAK();
+								GP.SUBMIT_MINI(" OK ", GP_ORANGE);
+							);
+						);
+
+						GP.BUTTON(String("_NSWd") + i, "Delete", "", GP_ORANGE, "20%", false, true);
+					}
+
+					GP.BUTTON("_NSWn", "New", "", GP_ORANGE, "45%", false, true);
 				);
 				M_BLOCK(GP_THIN,
 					GP.TITLE("AP");
@@ -152,6 +191,18 @@ void Web::init() {
 					GP.LABEL("Status:");
 					GP.SWITCH("_MSwf", mqtt->getWorkFlag());
 				);
+				M_BOX(GP_LEFT,
+					GP.LABEL("Async (no TLS):");
+					GP.SWITCH("_MSaf", mqtt->getAsyncFlag());
+				);
+				M_BOX(GP_LEFT,
+					GP.LABEL("Publish:");
+					GP.SELECT("_MSpm", "single,batch", mqtt->getPublishMode());
+				);
+				M_BOX(GP_LEFT,
+					GP.LABEL("Prefix:");
+					GP.TEXT("_MSp", "prefix", mqtt->getPrefix(), "60%", MQTT_PREFIX_SIZE);
+				);
 				
 				M_FORM2("/_MSS",
 					M_BLOCK(GP_THIN,
@@ -162,6 +213,15 @@ void Web::init() {
 						GP.SUBMIT_MINI(" OK ", GP_ORANGE);
 					);
 				);
+				M_BLOCK(GP_THIN,
+					GP.TITLE("TLS");
+
+					M_BOX(GP_LEFT,
+						GP.LABEL("Status:");
+						GP.SWITCH("_MStf", mqtt->getTlsFlag());
+					);
+					GP.TEXT("_MSf", "SHA1 fingerprint", mqtt->getFingerprint(), "100%", MQTT_FINGERPRINT_SIZE);
+				);
 				M_FORM2("/_MSA",
 					M_BLOCK(GP_THIN,
 						GP.TITLE("Access");
@@ -254,6 +314,7 @@ void Web::init() {
 
 			M_SPOILER("Relay", GP_ORANGE,
 				char select_array[20] = "NONE,";
+				char schedule[RELAY_SCHEDULE_SIZE];
 
 				for (uint8_t i = 0;i < sensors->getDS18B20Count();i++) {
 					strcat(select_array, sensors->getDS18B20Name(i));
@@ -263,42 +324,115 @@ void Web::init() {
 					}
 				}
 				
-				M_BOX(GP_LEFT,
-					GP.LABEL("Invert:");
-					GP.SWITCH("_RSif", relay->getInvertFlag());
-				);
+				for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+					M_BLOCK(GP_THIN,
+						GP.TITLE(String("Relay ") + (i + 1));
 
-				M_BOX(GP_LEFT,
-					GP.LABEL("Mode:");
-					GP.SELECT(String("_RSm"), "simple,thermostat", relay->getMode());
-				);
+						M_BOX(GP_LEFT,
+							GP.LABEL("Invert:");
+							GP.SWITCH(String("_RSif") + i, relay->getInvertFlag(i));
+						);
 
-				M_BLOCK(GP_THIN,
-					GP.TITLE("Thermostat");
-	
-					M_BOX(GP_LEFT,
-						GP.LABEL("Sensor:");
-						GP.SELECT("_RSTsi", select_array, relay->getThermSensor() + 1);
-					);
-	
-					M_BOX(GP_LEFT,
-						GP.LABEL("T:");
-						GP.NUMBER_F("_RSTst", "", relay->getThermSetT(), 2, "25%");
+						M_BOX(GP_LEFT,
+							GP.LABEL("Mode:");
+							GP.SELECT(String("_RSm") + i, "simple,thermostat,pid", relay->getMode(i));
+						);
+
+						M_BLOCK(GP_THIN,
+							GP.TITLE("Thermostat");
+
+							M_BOX(GP_LEFT,
+								GP.LABEL("Sensor:");
+								GP.SELECT(String("_RSTsi") + i, select_array, relay->getThermSensor(i) + 1);
+							);
+
+							M_BOX(GP_LEFT,
+								GP.LABEL("T:");
+								GP.NUMBER_F(String("_RSTst") + i, "", relay->getThermSetT(i), 2, "25%");
+							);
+
+							M_BOX(GP_LEFT,
+								GP.LABEL("Delta:");
+								GP.NUMBER_F(String("_RSTd") + i, "", relay->getThermDelta(i), 2, "25%");
+							);
+
+							M_BOX(GP_LEFT,
+								GP.LABEL("Mode:");
+								GP.SELECT(String("_RSTm") + i, "heating,cooling", relay->getThermMode(i));
+							);
+
+							M_BOX(GP_LEFT,
+								GP.LABEL("Error Rele:");
+								GP.SWITCH(String("_RSTerf") + i, relay->getThermErrorRelayFlag(i));
+							);
+						);
+
+						M_BLOCK(GP_THIN,
+							GP.TITLE("PID");
+
+							M_BOX(GP_LEFT,
+								GP.LABEL("Kp:");
+								GP.NUMBER_F(String("_RSPp") + i, "", relay->getPidKp(i), 2, "25%");
+							);
+
+							M_BOX(GP_LEFT,
+								GP.LABEL("Ki:");
+								GP.NUMBER_F(String("_RSPi") + i, "", relay->getPidKi(i), 2, "25%");
+							);
+
+							M_BOX(GP_LEFT,
+								GP.LABEL("Kd:");
+								GP.NUMBER_F(String("_RSPd") + i, "", relay->getPidKd(i), 2, "25%");
+							);
+
+							M_BOX(GP_LEFT,
+								GP.LABEL("Window, s:");
+								GP.NUMBER(String("_RSPw") + i, "", relay->getPidWindow(i), "25%");
+							);
+						);
+
+						M_BLOCK(GP_THIN,
+							GP.TITLE("Schedule");
+
+							M_BOX(GP_LEFT,
+								GP.LABEL("Enable:");
+								GP.SWITCH(String("_RSHf") + i, relay->getScheduleFlag(i));
+							);
+
+							// days 1 - Monday ... 7 - Sunday, '*' - every day
+							relay->printSchedule(i, schedule, RELAY_SCHEDULE_SIZE);
+							GP.TEXT(String("_RSHs") + i, "12345@06:30=21.5 67@08:00=22", schedule, "100%", RELAY_SCHEDULE_SIZE);
+
+							M_BOX(GP_LEFT,
+								GP.LABEL("Override T:");
+								GP.NUMBER_F(String("RSOt") + i, "", relay->getOverrideFlag(i) ? relay->getOverrideT(i) : relay->getTargetT(i), 2, "25%");
+							);
+
+							M_BOX(GP_LEFT,
+								GP.LABEL("For, min:");
+								GP.NUMBER(String("RSOm") + i, "0 - next", relay->getOverrideTime(i), "25%");
+								GP.BUTTON(String("RSOc") + i, "Cancel", "", GP_ORANGE, "30%");
+							);
+						);
 					);
+				}
+
+				M_BLOCK(GP_THIN,
+					GP.TITLE("Wear protection");
 
 					M_BOX(GP_LEFT,
-						GP.LABEL("Delta:");
-						GP.NUMBER_F("_RSTd", "", relay->getThermDelta(), 2, "25%");
+						GP.LABEL("Min on, s:");
+						GP.NUMBER("_RSWn", "", relay->getMinOnTime(), "25%");
 					);
 
 					M_BOX(GP_LEFT,
-						GP.LABEL("Mode:");
-						GP.SELECT(String("_RSTm"), "heating,cooling", relay->getThermMode());
+						GP.LABEL("Min off, s:");
+						GP.NUMBER("_RSWf", "", relay->getMinOffTime(), "25%");
 					);
 
 					M_BOX(GP_LEFT,
-						GP.LABEL("Error Rele:");
-						GP.SWITCH("_RSTerf", relay->getThermErrorRelayFlag());
+						GP.LABEL("Switches/h:");
+						GP.NUMBER("_RSWr", "", relay->getMaxSwitches(), "25%");
 					);
 				);
 			);
@@ -315,6 +449,11 @@ void Web::init() {
 					GP.NUMBER("_SSst", "", system->getSleepTime(), "25%");
 				);
 
+				M_BOX(GP_LEFT,
+					GP.LABEL("Time zone:");
+					GP.TEXT("_SStz", "TZ", system->getTimeZone(), "60%", SYSTEM_TZ_SIZE);
+				);
+
 				M_BLOCK(GP_THIN,
 					GP.TITLE("Management");
 	
@@ -329,6 +468,123 @@ void Web::init() {
 			GP.FILE_MANAGER(&LittleFS);
 			GP.FILE_UPLOAD("file");
 		}
+
+		if (ui.uri("/diag")) {
+#if PROFILER_ENABLED
+			Profiler* profiler = system->getProfiler();
+
+			M_BLOCK(GP_THIN,
+				GP.TITLE("Tick time, us");
+
+				M_TABLE(
+					GP.TR();
+					GP.TD(); GP.LABEL("");
+					GP.TD(); GP.LABEL("n");
+					GP.TD(); GP.LABEL("min");
+					GP.TD(); GP.LABEL("p50");
+					GP.TD(); GP.LABEL("p99");
+					GP.TD(); GP.LABEL("max");
+
+					for (uint8_t i = 0;i < PROFILER_SLOTS_COUNT;i++) {
+						GP.TR();
+						GP.TD(); GP.LABEL(profiler->getSlotName(i));
+						GP.TD(); GP.PLAIN(String(profiler->getCount(i)));
+						GP.TD(); GP.PLAIN(String(profiler->getMin(i)));
+						GP.TD(); GP.PLAIN(String(profiler->getPercentile(i, 50)));
+						GP.TD(); GP.PLAIN(String(profiler->getPercentile(i, 99)));
+						GP.TD(); GP.PLAIN(String(profiler->getMax(i)));
+					}
+				);
+			);
+
+			M_BLOCK(GP_THIN,
+				GP.TITLE("Histogram, < 2^n us");
+
+				for (uint8_t i = 0;i < PROFILER_SLOTS_COUNT;i++) {
+					String histogram;
+
+					for (uint8_t j = 0;j < PROFILER_BUCKETS_COUNT;j++) {
+						if (profiler->getBucket(i, j)) {
+							histogram += String(" ") + j + ":" + profiler->getBucket(i, j);
+						}
+					}
+
+					M_BOX(GP_LEFT,
+						GP.LABEL(String(profiler->getSlotName(i)) + ":");
+						GP.PLAIN(histogram);
+					);
+				}
+
+				GP.BUTTON("SPr", "Reset", "", GP_ORANGE, "45%");
+			);
+#endif
+
+			ReconnectPolicy* policies[] = {network->getReconnectPolicy(), mqtt->getReconnectPolicy(), blynk->getReconnectPolicy()};
+			const char* names[] = {"network", "mqtt", "blynk"};
+
+			M_BLOCK(GP_THIN,
+				GP.TITLE("Reconnects");
+
+				M_TABLE(
+					GP.TR();
+					GP.TD(); GP.LABEL("");
+					GP.TD(); GP.LABEL("tries");
+					GP.TD(); GP.LABEL("total");
+					GP.TD(); GP.LABEL("connects");
+					GP.TD(); GP.LABEL("last, ms");
+					GP.TD(); GP.LABEL("wait, ms");
+
+					for (uint8_t i = 0;i < 3;i++) {
+						GP.TR();
+						GP.TD(); GP.LABEL(names[i]);
+						GP.TD(); GP.PLAIN(String(policies[i]->getAttempts()));
+						GP.TD(); GP.PLAIN(String(policies[i]->getTotalAttempts()));
+						GP.TD(); GP.PLAIN(String(policies[i]->getConnects()));
+						GP.TD(); GP.PLAIN(String(policies[i]->getConnectTime()));
+						GP.TD(); GP.PLAIN(String(policies[i]->getWaitTime()));
+					}
+				);
+			);
+
+			M_BLOCK(GP_THIN,
+				GP.TITLE("MQTT queue");
+
+				M_BOX(GP.LABEL("RAM"); GP.PLAIN(String(mqtt->getQueue()->getRamCount())); );
+				M_BOX(GP.LABEL("Flash"); GP.PLAIN(String(mqtt->getQueue()->getSpillCount())); );
+				M_BOX(GP.LABEL("Dropped"); GP.PLAIN(String(mqtt->getQueue()->getDropped())); );
+				M_BOX(GP.LABEL("Enqueued"); GP.PLAIN(String(mqtt->getQueue()->getPushed())); );
+				M_BOX(GP.LABEL("Sent"); GP.PLAIN(String(mqtt->getStats()->sent)); );
+				M_BOX(GP.LABEL("Acked"); GP.PLAIN(String(mqtt->getStats()->acked)); );
+				M_BOX(GP.LABEL("Disconnects"); GP.PLAIN(String(mqtt->getStats()->disconnects)); );
+
+				GP.BUTTON("SMd", "Force disconnect", "", GP_ORANGE, "45%");
+			);
+
+			for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+				relay_stats_t* stats = relay->getStats(i);
+
+				M_BLOCK(GP_THIN,
+					GP.TITLE(String("Relay ") + (i + 1) + " wear");
+
+					M_BOX(GP.LABEL("Cycles"); GP.PLAIN(String(stats->cycles)); );
+					M_BOX(GP.LABEL("On time, h"); GP.PLAIN(String(stats->on_time / 3600)); );
+					M_BOX(GP.LABEL("Duty hour, %"); GP.PLAIN(String(stats->duty_hour / 10)); );
+					M_BOX(GP.LABEL("Duty day, %"); GP.PLAIN(String(stats->duty_day / 10)); );
+				);
+			}
+
+			M_BLOCK(GP_THIN,
+				GP.TITLE("Blynk traffic");
+
+				M_BOX(GP.LABEL("Sent"); GP.PLAIN(String(blynk->getStats()->sent)); );
+				M_BOX(GP.LABEL("Received"); GP.PLAIN(String(blynk->getStats()->received)); );
+				M_BOX(GP.LABEL("Pending"); GP.PLAIN(String(blynk->getPendingCount())); );
+				M_BOX(GP.LABEL("Disconnects"); GP.PLAIN(String(blynk->getStats()->disconnects)); );
+				M_BOX(GP.LABEL("Login, ms"); GP.PLAIN(String(blynk->getStats()->login_time)); );
+
+				GP.BUTTON("SBd", "Force disconnect", "", GP_ORANGE, "45%");
+			);
+		}
 	
 		GP.BUILD_END();
 	});
@@ -344,29 +600,37 @@ void Web::init() {
 		// update
 		for (uint8_t i = 0;i < sensors->getDS18B20Count();i++) {
 			if (ui.update(String("SDDt") + i)) {
-				ui.answer(!sensors->getDS18B20Status(i) ? String(sensors->getDS18B20T(i), 1) + "°" : String("err"));
+				ui.answer(String(!sensors->getDS18B20Status(i) ? formatT(sensors->getDS18B20T(i)) : "err"));
 				return;
 			}
 		}
 
-		if (ui.update("_RSrf")) {
-			ui.answer(relay->getRelayFlag());
-			return;
-		}
+		for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+			if (ui.update(String("_RSrf") + i)) {
+				ui.answer(relay->getRelayFlag(i));
+				return;
+			}
 
-		if (ui.update("RTDt")) {
-			ui.answer(!relay->getThermStatus() ? String(relay->getThermT(), 1) + "°" : String("err"));
-			return;
-		}
-		if (ui.update("RTDst")) {
-			ui.answer(String(relay->getThermSetT(), 1));
-			return;
+			if (ui.update(String("RTDt") + i)) {
+				ui.answer(String(!relay->getThermStatus(i) ? formatT(relay->getThermT(i)) : "err"));
+				return;
+			}
+			if (ui.update(String("RTDst") + i)) {
+				ui.answer(String(formatT(relay->getTargetT(i), false)));
+				return;
+			}
+			if (ui.update(String("RTDd") + i)) {
+				ui.answer(String(relay->getPidDuty(i) / 10) + "%");
+				return;
+			}
 		}
 
 		// parse
-		if (ui.click("_RSrf")) {
-			relay->setRelayFlag(ui.getBool());
-			return;
+		for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+			if (ui.click(String("_RSrf") + i)) {
+				relay->setRelayFlag(i, ui.getBool());
+				return;
+			}
 		}
 		/* --- Home --- */
 
@@ -381,9 +645,11 @@ void Web::init() {
 			return;
 		}
 	
-		if (ui.update("_NSWs")) {
-			ui.answer(network->getWifiSsid());
-			return;
+		for (uint8_t i = 0;i < network->getWifiCount();i++) {
+			if (ui.update(String("_NSWs") + i)) {
+				ui.answer(network->getWifiSsid(i));
+				return;
+			}
 		}
 	
 		if (ui.update("_NSAs")) {
@@ -401,14 +667,26 @@ void Web::init() {
 			return;
 		}
 	
-		if (ui.form("/_NSW")) {
-			char read_ssid[NETWORK_SSID_PASS_SIZE];
-			char read_pass[NETWORK_SSID_PASS_SIZE];
-	
-			ui.copyStr("_NSWs", read_ssid, NETWORK_SSID_PASS_SIZE);
-			ui.copyStr("_NSWp", read_pass, NETWORK_SSID_PASS_SIZE);
-	
-			network->setWifi(read_ssid, read_pass);
+		for (uint8_t i = 0;i < network->getWifiCount();i++) {
+			if (ui.form(String("/_NSW") + i)) {
+				char read_ssid[NETWORK_SSID_PASS_SIZE];
+				char read_pass[NETWORK_SSID_PASS_SIZE];
+		
+				ui.copyStr(String("_NSWs") + i, read_ssid, NETWORK_SSID_PASS_SIZE);
+				ui.copyStr(String("_NSWp") + i, read_pass, NETWORK_SSID_PASS_SIZE);
+		
+				network->setWifi(i, read_ssid, read_pass);
+				return;
+			}
+
+			if (ui.click(String("_NSWd") + i)) {
+				network->deleteWifi(i);
+				return;
+			}
+		}
+
+		if (ui.click("_NSWn")) {
+			network->addWifi();
 			return;
 		}
 	
@@ -432,6 +710,26 @@ void Web::init() {
 			ui.answer(mqtt->getWorkFlag());
 			return;
 		}
+		if (ui.update("_MSaf")) {
+			ui.answer(mqtt->getAsyncFlag());
+			return;
+		}
+		if (ui.update("_MSpm")) {
+			ui.answer(mqtt->getPublishMode());
+			return;
+		}
+		if (ui.update("_MSp")) {
+			ui.answer(mqtt->getPrefix());
+			return;
+		}
+		if (ui.update("_MStf")) {
+			ui.answer(mqtt->getTlsFlag());
+			return;
+		}
+		if (ui.update("_MSf")) {
+			ui.answer(mqtt->getFingerprint());
+			return;
+		}
 
 		if (ui.update("_MSSs")) {
 			ui.answer(mqtt->getServer());
@@ -456,6 +754,30 @@ void Web::init() {
 			mqtt->setWorkFlag(ui.getBool());
 			return;
 		}
+		if (ui.click("_MSaf")) {
+			mqtt->setAsyncFlag(ui.getBool());
+			return;
+		}
+		if (ui.click("_MSpm")) {
+			mqtt->setPublishMode(ui.getInt());
+			return;
+		}
+		if (ui.click("_MSp")) {
+			String read_string(ui.getString());
+			mqtt->setPrefix(&read_string);
+
+			return;
+		}
+		if (ui.click("_MStf")) {
+			mqtt->setTlsFlag(ui.getBool());
+			return;
+		}
+		if (ui.click("_MSf")) {
+			String read_string(ui.getString());
+			mqtt->setFingerprint(&read_string);
+
+			return;
+		}
 
 		if (ui.form("/_MSS")) {
 			char mqtt_server[MQTT_SERVER_SIZE];
@@ -629,62 +951,165 @@ void Web::init() {
 
 		/* --- RelayManager --- */
 		// update
-		if (ui.update("_RSif")) {
-			ui.answer(relay->getInvertFlag());
-			return;
-		}
-		if (ui.update("_RSm")) {
-			ui.answer(relay->getMode());
-			return;
-		}
-		if (ui.update("_RSTsi")) {
-			ui.answer(relay->getThermSensor() + 1);
-			return;
-		}
-		if (ui.update("_RSTst")) {
-			ui.answer(relay->getThermSetT());
-			return;
+		for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+			if (ui.update(String("_RSif") + i)) {
+				ui.answer(relay->getInvertFlag(i));
+				return;
+			}
+			if (ui.update(String("_RSm") + i)) {
+				ui.answer(relay->getMode(i));
+				return;
+			}
+			if (ui.update(String("_RSTsi") + i)) {
+				ui.answer(relay->getThermSensor(i) + 1);
+				return;
+			}
+			if (ui.update(String("_RSTst") + i)) {
+				ui.answer(relay->getThermSetT(i));
+				return;
+			}
+			if (ui.update(String("_RSTd") + i)) {
+				ui.answer(relay->getThermDelta(i));
+				return;
+			}
+			if (ui.update(String("_RSTm") + i)) {
+				ui.answer(relay->getThermMode(i));
+				return;
+			}
+			if (ui.update(String("_RSTerf") + i)) {
+				ui.answer(relay->getThermErrorRelayFlag(i));
+				return;
+			}
+			if (ui.update(String("_RSPp") + i)) {
+				ui.answer(relay->getPidKp(i));
+				return;
+			}
+			if (ui.update(String("_RSPi") + i)) {
+				ui.answer(relay->getPidKi(i));
+				return;
+			}
+			if (ui.update(String("_RSPd") + i)) {
+				ui.answer(relay->getPidKd(i));
+				return;
+			}
+			if (ui.update(String("_RSPw") + i)) {
+				ui.answer(relay->getPidWindow(i));
+				return;
+			}
+			if (ui.update(String("_RSHf") + i)) {
+				ui.answer(relay->getScheduleFlag(i));
+				return;
+			}
+			if (ui.update(String("_RSHs") + i)) {
+				char schedule[RELAY_SCHEDULE_SIZE];
+
+				relay->printSchedule(i, schedule, RELAY_SCHEDULE_SIZE);
+				ui.answer(String(schedule));
+				return;
+			}
+			if (ui.update(String("RSOt") + i)) {
+				ui.answer(relay->getOverrideFlag(i) ? relay->getOverrideT(i) : relay->getTargetT(i));
+				return;
+			}
+			if (ui.update(String("RSOm") + i)) {
+				ui.answer(relay->getOverrideTime(i));
+				return;
+			}
 		}
-		if (ui.update("_RSTd")) {
-			ui.answer(relay->getThermDelta());
+		if (ui.update("_RSWn")) {
+			ui.answer(relay->getMinOnTime());
 			return;
 		}
-		if (ui.update("_RSTm")) {
-			ui.answer(relay->getThermMode());
+		if (ui.update("_RSWf")) {
+			ui.answer(relay->getMinOffTime());
 			return;
 		}
-		if (ui.update("_RSTerf")) {
-			ui.answer(relay->getThermErrorRelayFlag());
+		if (ui.update("_RSWr")) {
+			ui.answer(relay->getMaxSwitches());
 			return;
 		}
 		
 		// parse
-		if (ui.click("_RSif")) {
-			relay->setInvertFlag(ui.getBool());
-			return;
-		}
-		if (ui.click("_RSm")) {
-			relay->setMode(ui.getInt());
-			return;
-		}
-		if (ui.click("_RSTsi")) {
-			relay->setThermSensor(ui.getInt() - 1);
-			return;
-		}
-		if (ui.click("_RSTst")) {
-			relay->setThermSetT(ui.getFloat());
-			return;
+		for (uint8_t i = 0;i < RELAY_CHANNELS_COUNT;i++) {
+			if (ui.click(String("_RSif") + i)) {
+				relay->setInvertFlag(i, ui.getBool());
+				return;
+			}
+			if (ui.click(String("_RSm") + i)) {
+				relay->setMode(i, ui.getInt());
+				return;
+			}
+			if (ui.click(String("_RSTsi") + i)) {
+				relay->setThermSensor(i, ui.getInt() - 1);
+				return;
+			}
+			if (ui.click(String("_RSTst") + i)) {
+				relay->setThermSetT(i, ui.getFloat());
+				return;
+			}
+			if (ui.click(String("_RSTd") + i)) {
+				relay->setThermDelta(i, ui.getFloat());
+				return;
+			}
+			if (ui.click(String("_RSTm") + i)) {
+				relay->setThermMode(i, ui.getInt());
+				return;
+			}
+			if (ui.click(String("_RSTerf") + i)) {
+				relay->setThermErrorRelayFlag(i, ui.getBool());
+				return;
+			}
+			if (ui.click(String("_RSPp") + i)) {
+				relay->setPidKp(i, ui.getFloat());
+				return;
+			}
+			if (ui.click(String("_RSPi") + i)) {
+				relay->setPidKi(i, ui.getFloat());
+				return;
+			}
+			if (ui.click(String("_RSPd") + i)) {
+				relay->setPidKd(i, ui.getFloat());
+				return;
+			}
+			if (ui.click(String("_RSPw") + i)) {
+				relay->setPidWindow(i, ui.getInt());
+				return;
+			}
+			if (ui.click(String("_RSHf") + i)) {
+				relay->setScheduleFlag(i, ui.getBool());
+				return;
+			}
+			if (ui.click(String("_RSHs") + i)) {
+				String read_string(ui.getString());
+				relay->setSchedule(i, &read_string);
+
+				return;
+			}
+
+			// either field (re)starts the override, the other one keeps its value
+			if (ui.click(String("RSOt") + i)) {
+				relay->setOverride(i, ui.getFloat(), relay->getOverrideTime(i));
+				return;
+			}
+			if (ui.click(String("RSOm") + i)) {
+				relay->setOverride(i, relay->getOverrideFlag(i) ? relay->getOverrideT(i) : relay->getTargetT(i), ui.getInt());
+				return;
+			}
+			if (ui.click(String("RSOc") + i)) {
+				relay->cancelOverride(i);
+				return;
+			}
 		}
-		if (ui.click("_RSTd")) {
-			relay->setThermDelta(ui.getFloat());
+		if (ui.click("_RSWn")) {
+			relay->setMinOnTime(ui.getInt());
 			return;
 		}
-		if (ui.click("_RSTm")) {
-			relay->setThermMode(ui.getInt());
+		if (ui.click("_RSWf")) {
+			relay->setMinOffTime(ui.getInt());
 			return;
 		}
-		if (ui.click("_RSTerf")) {
-			relay->setThermErrorRelayFlag(ui.getBool());
+		if (ui.click("_RSWr")) {
+			relay->setMaxSwitches(ui.getInt());
 			return;
 		}
 		/* --- RelayManager --- */
@@ -699,6 +1124,10 @@ void Web::init() {
 			ui.answer(system->getSleepTime());
 			return;
 		}
+		if (ui.update("_SStz")) {
+			ui.answer(String(system->getTimeZone()));
+			return;
+		}
 
 		// parse
 		if (ui.click("_SSsf")) {
@@ -707,15 +1136,38 @@ void Web::init() {
 		}
 		if (ui.click("_SSst")) {
 			system->setSleepTime(ui.getInt());
+			return;
+		}
+		if (ui.click("_SStz")) {
+			String read_string(ui.getString());
+			system->setTimeZone(&read_string);
+
 			return;
 		}	
 
 		if (ui.click("SSr")) {
-			ESP.reset();
+			system->reset();
 		}
 		if (ui.click("SSra")) {
 			system->resetAll();
 		}
+
+		if (ui.click("SMd")) {
+			mqtt->forceDisconnect();
+			return;
+		}
+
+		if (ui.click("SBd")) {
+			blynk->forceDisconnect();
+			return;
+		}
+
+#if PROFILER_ENABLED
+		if (ui.click("SPr")) {
+			system->getProfiler()->makeDefault();
+			return;
+		}
+#endif
 		/* --- SystemManager --- */
 	});
 
@@ -772,4 +1224,13 @@ void Web::updateBlynkBlock() {
 			blynk_block.element_codes_string += ',';
 		}
 	}
-}
\ No newline at end of file
+}
+const char* Web::formatT(float t, bool degrees) {
+	formatFloat(format_buffer, FORMAT_BUFFER_SIZE, t, WEB_VALUE_DECIMALS);
+
+	if (degrees) {
+		strlcat(format_buffer, "°", FORMAT_BUFFER_SIZE);
+	}
+
+	return format_buffer;
+}
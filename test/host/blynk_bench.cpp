@@ -0,0 +1,335 @@
+/*
+ * Project: Temperature Tick
+ *
+ * Author: Vereshchynskyi Nazar
+ * Email: verechnazar12@gmail.com
+ * Version: 1.0.0
+ * Date: 02.03.2025
+ *
+ * Host benchmark of the Blynk send paths against pseudo-server-bench.py.
+ *
+ * Every period all links get a new value. In "single" mode each value is written
+ * at once followed by the 10 ms pause of the original handleEvent(). In "group" mode
+ * the values land in dirty slots and go out as one group per BLYNK_SEND_INTERVAL, as
+ * BlynkManager::addWrite()/sendWrites() do. The server echoes every write back, so
+ * the round trip covers both directions.
+ */
+
+#define BLYNK_MSG_LIMIT 0 // as on the device, pacing is done by the caller
+#define BLYNK_SEND_ATOMIC // one write() per frame, as on ESP8266
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <BlynkApiLinux.h>
+#include <Blynk/BlynkProtocol.h>
+
+#include <algorithm>
+#include <vector>
+
+#define BENCH_LINKS_MAX 32
+#define BENCH_IDS_SIZE 65536 // produce times kept per value id, ring
+#define BENCH_WRITE_DELAY 10 // ms, the pause after every write in the per-write path
+#define BENCH_SEND_INTERVAL 100 // ms, BLYNK_SEND_INTERVAL
+
+static uint64_t nowUs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* --- transport --- */
+// BlynkTransportSocket polls with a 10 ms sleep and never notices a closed peer, both would skew the numbers
+class BenchTransport {
+public:
+	BenchTransport() : sockfd(-1), host(NULL), port(0), frames_out(0), connect_us(0) {}
+
+	void begin(const char* host, uint16_t port) {
+		this->host = host;
+		this->port = port;
+	}
+
+	bool connect() {
+		struct addrinfo hints;
+		struct addrinfo* res = NULL;
+		char port_str[8];
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		snprintf(port_str, sizeof(port_str), "%u", port);
+
+		if (getaddrinfo(host, port_str, &hints, &res) || res == NULL) {
+			return false;
+		}
+
+		uint64_t start = nowUs();
+		sockfd = ::socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+
+		if (sockfd < 0 || ::connect(sockfd, res->ai_addr, res->ai_addrlen) < 0) {
+			freeaddrinfo(res);
+			disconnect();
+			return false;
+		}
+		freeaddrinfo(res);
+		connect_us = nowUs() - start;
+
+		int one = 1;
+		setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		return true;
+	}
+
+	void disconnect() {
+		if (sockfd >= 0) {
+			::close(sockfd);
+			sockfd = -1;
+		}
+	}
+
+	size_t read(void* buf, size_t len) {
+		size_t done = 0;
+
+		// frames are read whole, wait for the rest of a partly arrived one
+		while (done < len) {
+			ssize_t r = ::recv(sockfd, (uint8_t*) buf + done, len - done, 0);
+
+			if (r <= 0) {
+				disconnect();
+				return done;
+			}
+			done += r;
+		}
+
+		return done;
+	}
+
+	size_t write(const void* buf, size_t len) {
+		ssize_t w = ::send(sockfd, buf, len, MSG_NOSIGNAL);
+
+		if (w <= 0) {
+			disconnect();
+			return 0;
+		}
+
+		frames_out++;
+		return w;
+	}
+
+	bool connected() {
+		return sockfd >= 0;
+	}
+
+	int available() {
+		if (!connected()) {
+			return 0;
+		}
+
+		struct pollfd fd = { sockfd, POLLIN, 0 };
+		if (poll(&fd, 1, 0) <= 0) {
+			return 0;
+		}
+
+		int count = 0;
+		ioctl(sockfd, FIONREAD, &count);
+
+		// readable with nothing to read - the server closed the connection
+		if (!count) {
+			disconnect();
+		}
+
+		return count;
+	}
+
+	int sockfd;
+	const char* host;
+	uint16_t port;
+
+	uint32_t frames_out;
+	uint64_t connect_us;
+};
+
+class BenchBlynk : public BlynkProtocol<BenchTransport> {
+	typedef BlynkProtocol<BenchTransport> Base;
+public:
+	BenchBlynk(BenchTransport& transport) : Base(transport) {}
+
+	void begin(const char* auth, const char* host, uint16_t port) {
+		Base::begin(auth);
+		this->conn.begin(host, port);
+	}
+};
+
+static BenchTransport _blynkTransport;
+BenchBlynk Blynk(_blynkTransport);
+
+#include <BlynkWidgets.h>
+
+/* --- state --- */
+static uint8_t links_count = 20;
+static uint32_t links_mask;
+
+static uint64_t produce_us[BENCH_IDS_SIZE];
+static std::vector<uint32_t> rtt_us;
+static uint32_t writes_in;
+static uint32_t pushes_in;
+
+BLYNK_WRITE_DEFAULT() {
+	uint8_t pin = request.pin;
+
+	if (pin >= links_count) {
+		pushes_in++;
+		return;
+	}
+
+	uint32_t id = param.asLongLong();
+	writes_in++;
+
+	if (produce_us[id % BENCH_IDS_SIZE]) {
+		rtt_us.push_back(nowUs() - produce_us[id % BENCH_IDS_SIZE]);
+		produce_us[id % BENCH_IDS_SIZE] = 0;
+	}
+}
+
+static std::vector<uint32_t> reconnect_us;
+static std::vector<uint32_t> tcp_us;
+static uint64_t disconnect_us;
+static bool connected_flag = true;
+
+// a failed write drops the link inside virtualWrite(), so this runs after sending too
+static void trackConnection() {
+	if (connected_flag == Blynk.connected()) {
+		return;
+	}
+	connected_flag = Blynk.connected();
+
+	if (!connected_flag) {
+		disconnect_us = nowUs();
+	}
+	else {
+		reconnect_us.push_back(nowUs() - disconnect_us);
+		tcp_us.push_back(_blynkTransport.connect_us);
+	}
+}
+
+static uint32_t percentile(std::vector<uint32_t>* samples, uint8_t percent) {
+	if (samples->empty()) {
+		return 0;
+	}
+
+	size_t index = (samples->size() - 1) * percent / 100;
+	std::nth_element(samples->begin(), samples->begin() + index, samples->end());
+
+	return (*samples)[index];
+}
+
+int main(int argc, char* argv[]) {
+	static struct option long_options[] = {
+		{"mode",     required_argument, 0, 'm'},
+		{"server",   required_argument, 0, 's'},
+		{"port",     required_argument, 0, 'p'},
+		{"links",    required_argument, 0, 'l'},
+		{"period",   required_argument, 0, 'r'},
+		{"duration", required_argument, 0, 'd'},
+		{0, 0, 0, 0}
+	};
+
+	bool group_flag = true;
+	const char* server = "127.0.0.1";
+	uint16_t port = 8442;
+	uint32_t period = 1000; // ms between readings of all links
+	uint32_t duration = 20; // sec
+
+	int c;
+	while ((c = getopt_long(argc, argv, "m:s:p:l:r:d:", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'm': group_flag = strcmp(optarg, "single"); break;
+			case 's': server = optarg; break;
+			case 'p': port = atoi(optarg); break;
+			case 'l': links_count = std::min(atoi(optarg), BENCH_LINKS_MAX); break;
+			case 'r': period = atoi(optarg); break;
+			case 'd': duration = atoi(optarg); break;
+			default:
+				fprintf(stderr, "Usage: blynk_bench [--mode=single|group] [--server=addr] [--port=num] [--links=n] [--period=ms] [--duration=sec]\n");
+				return 2;
+		}
+	}
+
+	Blynk.begin("bench", server, port);
+
+	if (!Blynk.connect()) {
+		fprintf(stderr, "Can't reach the pseudo-server at %s:%u\n", server, port);
+		return 1;
+	}
+
+	uint32_t values[BENCH_LINKS_MAX];
+	uint32_t next_id = 1;
+	uint32_t produced = 0;
+	uint32_t writes_out = 0;
+
+	uint64_t start_us = nowUs();
+	uint64_t produce_timer = 0;
+	uint64_t send_timer = 0;
+
+	while (nowUs() - start_us < (uint64_t) duration * 1000000) {
+		Blynk.run();
+		trackConnection();
+		uint64_t now = nowUs();
+
+		if (now - produce_timer >= (uint64_t) period * 1000) {
+			produce_timer = now;
+
+			for (uint8_t i = 0;i < links_count;i++) {
+				values[i] = next_id++;
+				produce_us[values[i] % BENCH_IDS_SIZE] = now;
+				produced++;
+
+				if (!group_flag) {
+					if (Blynk.connected()) {
+						Blynk.virtualWrite(i, values[i]);
+						writes_out++;
+					}
+					BlynkDelay(BENCH_WRITE_DELAY);
+				}
+				else {
+					// a newer value replaces one still waiting
+					links_mask |= 1UL << i;
+				}
+			}
+		}
+
+		if (group_flag && links_mask && Blynk.connected() && now - send_timer >= BENCH_SEND_INTERVAL * 1000) {
+			Blynk.beginGroup();
+			for (uint8_t i = 0;i < links_count;i++) {
+				if (links_mask & (1UL << i)) {
+					Blynk.virtualWrite(i, values[i]);
+					writes_out++;
+				}
+			}
+			Blynk.endGroup();
+
+			links_mask = 0;
+			send_timer = now;
+		}
+
+		trackConnection();
+	}
+
+	double seconds = (nowUs() - start_us) / 1e6;
+
+	printf("mode=%s links=%u period_ms=%u duration_s=%.1f\n", group_flag ? "group" : "single", links_count, period, seconds);
+	printf("  values produced %u, written %u, echoed %u, lost %u, server pushes %u\n", produced, writes_out, writes_in, produced - writes_in, pushes_in);
+	printf("  frames out %.1f/s, writes out %.1f/s, writes in %.1f/s\n", _blynkTransport.frames_out / seconds, writes_out / seconds, (writes_in + pushes_in) / seconds);
+	printf("  round trip ms p50 %.2f p99 %.2f max %.2f (%u samples)\n", percentile(&rtt_us, 50) / 1000.0, percentile(&rtt_us, 99) / 1000.0, percentile(&rtt_us, 100) / 1000.0, (uint32_t) rtt_us.size());
+	printf("  reconnects %u, ms p50 %.2f max %.2f, tcp connect ms p50 %.2f\n", (uint32_t) reconnect_us.size(), percentile(&reconnect_us, 50) / 1000.0, percentile(&reconnect_us, 100) / 1000.0, percentile(&tcp_us, 50) / 1000.0);
+
+	return 0;
+}
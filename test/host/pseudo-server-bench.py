@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+'''
+ Pseudo-server for blynk_bench, modelled on lib/Blynk/tests/pseudo-server-*.py.
+
+ It accepts any token and echoes every virtual write it receives back to the
+ same pin, so the device sees its own values return (device -> server ->
+ device round trip). Optionally it pushes writes of its own to one pin and
+ drops the connection on a period to exercise reconnects.
+
+   pseudo-server-bench.py --port=8442 --push=5 --drop=10
+
+ Options:
+   -b, --bind=addr    Address to bind (default: all interfaces)
+   -p, --port=num     Port to listen on (default: 8442)
+   --push=rate        Server originated writes per sec (default: 0)
+   --push-pin=num     Virtual pin for the pushed writes (default: 127)
+   --drop=sec         Close each connection after this long (default: never)
+   --dump             Print every frame
+'''
+import select, socket, struct
+import sys, time, getopt
+from threading import Thread
+
+try:
+	opts, args = getopt.getopt(sys.argv[1:],
+	    "hb:p:",
+	    ["help", "bind=", "port=", "push=", "push-pin=", "drop=", "dump"])
+except getopt.GetoptError:
+	print(__doc__, file=sys.stderr)
+	sys.exit(2)
+
+HOST = ''
+PORT = 8442
+PUSH = 0.0
+PUSH_PIN = 127
+DROP = 0.0
+DUMP = 0
+
+for o, v in opts:
+	if o in ("-h", "--help"):
+		print(__doc__)
+		sys.exit()
+	elif o in ("-b", "--bind"):
+		HOST = v
+	elif o in ("-p", "--port"):
+		PORT = int(v)
+	elif o in ("--push",):
+		PUSH = float(v)
+	elif o in ("--push-pin",):
+		PUSH_PIN = int(v)
+	elif o in ("--drop",):
+		DROP = float(v)
+	elif o in ("--dump",):
+		DUMP = 1
+
+# Blynk protocol helpers
+
+hdr = struct.Struct("!BHH")
+
+class MsgType:
+	RSP      = 0
+	LOGIN    = 2
+	HW_LOGIN = 29
+	PING     = 6
+	HW       = 20
+	GROUP    = 21
+	INTERNAL = 17
+
+class MsgStatus:
+	OK = 200
+
+start_time = time.time()
+def log(msg):
+	print("[{:7.3f}] {:}".format(time.time() - start_time, msg), flush=True)
+
+def dump(msg):
+	if DUMP:
+		log(msg)
+
+def receive(sock, length):
+	d = b''
+	while len(d) < length:
+		r = sock.recv(length - len(d))
+		if not r:
+			return b''
+		d += r
+	return d
+
+class Connection:
+	def __init__(self, conn, addr):
+		self.conn = conn
+		self.addr = addr
+		self.msg_id = 0
+		self.frames_in = 0
+		self.writes_in = 0
+		self.groups_in = 0
+		self.writes_out = 0
+
+	def send_hw(self, *args):
+		data = b"\0".join(str(a).encode() for a in args)
+		# the device rejects id 0
+		self.msg_id = self.msg_id % 0xFFFF + 1
+		self.conn.sendall(hdr.pack(MsgType.HW, self.msg_id, len(data)) + data)
+		self.writes_out += 1
+
+	def handle(self):
+		data = receive(self.conn, hdr.size)
+		if not data:
+			return False
+
+		msg_type, msg_id, msg_len = hdr.unpack(data)
+		self.frames_in += 1
+
+		if msg_type == MsgType.RSP:
+			return True
+
+		body = receive(self.conn, msg_len) if msg_len else b''
+		if msg_len and not body:
+			return False
+
+		if msg_type in (MsgType.LOGIN, MsgType.HW_LOGIN):
+			log("Auth {0}".format(body.decode(errors="replace")))
+			self.conn.sendall(hdr.pack(MsgType.RSP, msg_id, MsgStatus.OK))
+		elif msg_type == MsgType.PING:
+			self.conn.sendall(hdr.pack(MsgType.RSP, msg_id, MsgStatus.OK))
+		elif msg_type == MsgType.HW:
+			parts = body.split(b"\0")
+			dump("> " + " ".join(p.decode(errors="replace") for p in parts))
+			if len(parts) >= 3 and parts[0] == b"vw":
+				self.writes_in += 1
+				self.send_hw("vw", parts[1].decode(), parts[2].decode())
+		elif msg_type == MsgType.GROUP:
+			dump("> group " + body.decode(errors="replace"))
+			if body.startswith(b"b") or body.startswith(b"t"):
+				self.groups_in += 1
+		elif msg_type == MsgType.INTERNAL:
+			pass
+		else:
+			log("Unknown msg type {0}".format(msg_type))
+			return False
+		return True
+
+def clientthread(conn, addr):
+	log('Connection from {0}:{1}'.format(addr[0], str(addr[1])))
+	conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+	c = Connection(conn, addr)
+	proc_start = time.time()
+	push_timer = proc_start
+	push_value = 0
+
+	try:
+		while True:
+			now = time.time()
+			if DROP and now - proc_start >= DROP:
+				log("Dropping the connection")
+				break
+
+			if PUSH and now - push_timer >= 1.0 / PUSH:
+				push_timer += 1.0 / PUSH
+				push_value += 1
+				c.send_hw("vw", PUSH_PIN, push_value)
+
+			rs, ws, es = select.select([conn], [], [conn], 0.005)
+			if es:
+				log("Socket error")
+				break
+			if rs and not c.handle():
+				break
+	except (ConnectionError, OSError) as e:
+		log("Connection error: {0}".format(e))
+
+	log("Time {0:.3f}, frames in {1}, writes in {2}, groups in {3}, writes out {4}".format(
+		time.time() - proc_start, c.frames_in, c.writes_in, c.groups_in, c.writes_out))
+	conn.close()
+
+# Main code
+
+serv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+try:
+	serv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+	serv.bind((HOST, PORT))
+except socket.error as msg:
+	log('Bind failed: {0}'.format(msg))
+	sys.exit(1)
+
+serv.listen(10)
+log('Listening on port %d' % PORT)
+
+# every reconnect is a new client, serve them until killed
+while True:
+	conn, addr = serv.accept()
+	Thread(target=clientthread, args=(conn, addr), daemon=True).start()
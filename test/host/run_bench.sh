@@ -0,0 +1,20 @@
+#!/bin/bash
+# Runs blynk_bench on both send paths against a local pseudo-server.
+#   ./run_bench.sh [duration sec] [links] [push rate] [drop sec]
+
+DURATION=${1:-20}
+LINKS=${2:-20}
+PUSH=${3:-5}
+DROP=${4:-8}
+PORT=${PORT:-8442}
+
+cd "$(dirname "$0")"
+
+python3 pseudo-server-bench.py --port=$PORT --push=$PUSH --drop=$DROP > pseudo-server.log 2>&1 &
+SERVER=$!
+trap "kill $SERVER 2>/dev/null" EXIT
+sleep 0.5
+
+for MODE in single group; do
+    ./blynk_bench --mode=$MODE --port=$PORT --links=$LINKS --duration=$DURATION || exit 1
+done
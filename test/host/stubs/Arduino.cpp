@@ -0,0 +1,70 @@
+/*
+ * Host fakes for the ESP8266 core, see Arduino.h.
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+unsigned long fake_millis = 0;
+uint8_t fake_pins[32];
+HardwareSerial Serial;
+EspClass ESP;
+LittleFSClass LittleFS;
+
+FakeFiles fake_files;
+size_t fake_fs_limit = 1 << 20;
+uint32_t fake_fs_writes = 0;
+
+static uint32_t fake_random = 1;
+static uint32_t fake_rtc[128];
+
+unsigned long millis() {
+	return fake_millis;
+}
+
+unsigned long micros() {
+	return fake_millis * 1000;
+}
+
+void delay(unsigned long ms) {
+	fake_millis += ms;
+}
+
+void yield() {}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+	fake_pins[pin % 32] = value;
+}
+
+int digitalRead(uint8_t pin) {
+	return fake_pins[pin % 32];
+}
+
+uint32_t EspClass::random() {
+	// xorshift, repeatable from run to run
+	fake_random ^= fake_random << 13;
+	fake_random ^= fake_random >> 17;
+	fake_random ^= fake_random << 5;
+
+	return fake_random;
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size) {
+	if (offset * 4 + size > sizeof(fake_rtc)) {
+		return false;
+	}
+
+	memcpy(data, (uint8_t*) fake_rtc + offset * 4, size);
+	return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size) {
+	if (offset * 4 + size > sizeof(fake_rtc)) {
+		return false;
+	}
+
+	memcpy((uint8_t*) fake_rtc + offset * 4, data, size);
+	return true;
+}
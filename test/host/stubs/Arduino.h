@@ -0,0 +1,136 @@
+/*
+ * Host stand-in for the parts of the ESP8266 Arduino core that data.h and the
+ * host-tested sources use. Time and the RTC memory are faked so tests can drive them.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define D1 5
+#define D5 14
+#define D6 12
+#define D7 13
+
+#define PROGMEM
+#define F(string) (string)
+
+typedef uint8_t byte;
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+	size_t length = strlen(src);
+
+	if (size) {
+		size_t copy = (length < size - 1) ? length : size - 1;
+		memcpy(dst, src, copy);
+		dst[copy] = 0;
+	}
+
+	return length;
+}
+#endif
+
+// as in the ESP8266 core, mixed argument types are allowed
+template <class T, class L>
+auto min(const T& a, const L& b) -> decltype((b < a) ? b : a) {
+	return (b < a) ? b : a;
+}
+
+template <class T, class L>
+auto max(const T& a, const L& b) -> decltype((b < a) ? b : a) {
+	return (a < b) ? b : a;
+}
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+extern unsigned long fake_millis;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+extern uint8_t fake_pins[32];
+
+class String {
+public:
+	String(const char* str = "") : value(str ? str : "") {}
+	String(const std::string& str) : value(str) {}
+	String(char c) : value(1, c) {}
+	String(int number) : value(std::to_string(number)) {}
+	String(unsigned int number) : value(std::to_string(number)) {}
+	String(long number) : value(std::to_string(number)) {}
+	String(unsigned long number) : value(std::to_string(number)) {}
+	String(float number, unsigned char decimals = 2) : value(format(number, decimals)) {}
+	String(double number, unsigned char decimals = 2) : value(format(number, decimals)) {}
+
+	const char* c_str() const { return value.c_str(); }
+	unsigned int length() const { return value.length(); }
+	long toInt() const { return atol(value.c_str()); }
+	float toFloat() const { return atof(value.c_str()); }
+	void toCharArray(char* buffer, unsigned int size) const { snprintf(buffer, size, "%s", value.c_str()); }
+
+	String& operator+=(const String& other) { value += other.value; return *this; }
+	bool operator==(const String& other) const { return value == other.value; }
+	bool operator!=(const String& other) const { return value != other.value; }
+	friend String operator+(const String& a, const String& b) { return String(a.value + b.value); }
+
+private:
+	static std::string format(double number, unsigned char decimals) {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.*f", decimals, number);
+		return buffer;
+	}
+
+	std::string value;
+};
+
+class HardwareSerial {
+public:
+	void begin(unsigned long) {}
+	template <class T> size_t print(T) { return 0; }
+	template <class T> size_t println(T) { return 0; }
+	size_t println() { return 0; }
+	size_t printf(const char*, ...) { return 0; }
+};
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+	uint32_t getCycleCount() { return micros() * 80; }
+	uint8_t getCpuFreqMHz() { return 80; }
+	uint32_t getFreeHeap() { return 40000; }
+	uint32_t getChipId() { return 0x123456; }
+	uint32_t random();
+	bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size);
+	bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size);
+	void reset() {}
+	void deepSleep(uint64_t) {}
+};
+extern EspClass ESP;
+
+class IPAddress {
+public:
+	IPAddress(uint32_t address = 0) : address(address) {}
+	IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address(a | b << 8 | c << 16 | (uint32_t) d << 24) {}
+	operator uint32_t() const { return address; }
+
+private:
+	uint32_t address;
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <ESP8266WiFi.h>
+
+#define BLYNK_DEFAULT_DOMAIN "blynk.cloud"
+#define BLYNK_DEFAULT_PORT 80
+#define BLYNK_TIMEOUT_MS 6000UL
+
+template <class Client>
+class BlynkArduinoClientGen {
+public:
+	BlynkArduinoClientGen(Client& client) {}
+};
+typedef BlynkArduinoClientGen<WiFiClient> BlynkArduinoClient;
+
+class BlynkWifi {
+public:
+	BlynkWifi(BlynkArduinoClient& transport) {}
+};
+
+class BlynkParam;
+struct BlynkReq;
+#define BLYNK_WRITE_DEFAULT() void BlynkWidgetWriteDefault(BlynkReq& request, const BlynkParam& param)
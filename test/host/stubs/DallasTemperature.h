@@ -0,0 +1,14 @@
+#pragma once
+#include <Arduino.h>
+
+typedef uint8_t DeviceAddress[8];
+
+class OneWire {
+public:
+	OneWire(uint8_t pin = 0) {}
+};
+
+class DallasTemperature {
+public:
+	DallasTemperature(OneWire* wire = NULL) {}
+};
@@ -0,0 +1,47 @@
+/*
+ * Host stand-in for nazotronic/dynamic-array, only what the host-built sources use.
+ */
+
+#pragma once
+#include <stdint.h>
+
+template <class T>
+class DynamicArray {
+public:
+	DynamicArray() : items(new T[DYNAMIC_ARRAY_HOST_SIZE]), count(0), max_size(DYNAMIC_ARRAY_HOST_SIZE) {}
+	~DynamicArray() { delete[] items; }
+
+	bool add(const T& item) {
+		if (count >= max_size) {
+			return false;
+		}
+
+		items[count++] = item;
+		return true;
+	}
+
+	bool del(uint16_t index) {
+		if (index >= count) {
+			return false;
+		}
+
+		for (uint16_t i = index;i + 1 < count;i++) {
+			items[i] = items[i + 1];
+		}
+		count--;
+
+		return true;
+	}
+
+	void clear() { count = 0; }
+	void setMaxSize(uint16_t size) { max_size = (size < DYNAMIC_ARRAY_HOST_SIZE) ? size : DYNAMIC_ARRAY_HOST_SIZE; }
+	uint16_t size() { return count; }
+	T& operator[](uint16_t index) { return items[index]; }
+
+private:
+	enum { DYNAMIC_ARRAY_HOST_SIZE = 64 };
+
+	T* items;
+	uint16_t count;
+	uint16_t max_size;
+};
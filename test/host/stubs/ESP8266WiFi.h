@@ -0,0 +1,30 @@
+#pragma once
+#include <Arduino.h>
+#include <functional>
+#include <memory>
+
+typedef enum {
+	WL_IDLE_STATUS = 0,
+	WL_NO_SSID_AVAIL = 1,
+	WL_CONNECTED = 3,
+	WL_CONNECT_FAILED = 4,
+	WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef std::shared_ptr<void> WiFiEventHandler;
+
+class WiFiClient {
+public:
+	virtual ~WiFiClient() {}
+	virtual int connect(IPAddress ip, uint16_t port) { return 0; }
+	virtual int connect(const char* host, uint16_t port) { return 0; }
+	void setTimeout(unsigned long) {}
+};
+
+class WiFiClientSecure : public WiFiClient {};
+
+namespace BearSSL {
+	class Session {
+		uint8_t data[96];
+	};
+}
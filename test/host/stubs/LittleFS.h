@@ -0,0 +1,114 @@
+#pragma once
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <string>
+
+// files live in memory, fake_fs_limit caps the total size to model a full flash
+typedef std::map<std::string, std::shared_ptr<std::string>> FakeFiles;
+extern FakeFiles fake_files;
+extern size_t fake_fs_limit;
+extern uint32_t fake_fs_writes; // write() calls, each is a flash write on the device
+
+class File {
+public:
+	File() : position_(0) {}
+	File(std::shared_ptr<std::string> data, size_t position) : data_(data), position_(position) {}
+
+	operator bool() const { return (bool) data_; }
+	size_t size() { return data_ ? data_->size() : 0; }
+	size_t position() { return position_; }
+
+	bool seek(uint32_t position) {
+		if (!data_ || position > data_->size()) {
+			return false;
+		}
+
+		position_ = position;
+		return true;
+	}
+
+	size_t read(uint8_t* buffer, size_t size) {
+		if (!data_ || position_ >= data_->size()) {
+			return 0;
+		}
+
+		size = min(size, data_->size() - position_);
+		memcpy(buffer, data_->data() + position_, size);
+		position_ += size;
+
+		return size;
+	}
+
+	size_t write(const uint8_t* buffer, size_t size) {
+		if (!data_) {
+			return 0;
+		}
+
+		size_t used = 0;
+		for (FakeFiles::iterator it = fake_files.begin();it != fake_files.end();it++) {
+			used += it->second->size();
+		}
+
+		fake_fs_writes++;
+		size = min(size, (fake_fs_limit > used) ? fake_fs_limit - used : (size_t) 0);
+		data_->replace(position_, min(size, data_->size() - position_), (const char*) buffer, size);
+		position_ += size;
+
+		return size;
+	}
+
+	bool truncate(uint32_t size) {
+		if (!data_ || size > data_->size()) {
+			return false;
+		}
+
+		data_->resize(size);
+		return true;
+	}
+
+	void close() {
+		data_.reset();
+	}
+
+private:
+	std::shared_ptr<std::string> data_;
+	size_t position_;
+};
+
+class LittleFSClass {
+public:
+	bool begin() { return true; }
+
+	File open(const char* path, const char* mode) {
+		FakeFiles::iterator it = fake_files.find(path);
+
+		if (mode[0] == 'r') {
+			return (it != fake_files.end()) ? File(it->second, 0) : File();
+		}
+		if (mode[0] == 'w' || it == fake_files.end()) {
+			fake_files[path] = std::make_shared<std::string>();
+		}
+
+		std::shared_ptr<std::string> data = fake_files[path];
+		return File(data, (mode[0] == 'a') ? data->size() : 0);
+	}
+
+	bool exists(const char* path) { return fake_files.count(path); }
+	bool remove(const char* path) { return fake_files.erase(path); }
+
+	bool rename(const char* from, const char* to) {
+		FakeFiles::iterator it = fake_files.find(from);
+
+		if (it == fake_files.end()) {
+			return false;
+		}
+
+		fake_files[to] = it->second;
+		fake_files.erase(from);
+
+		return true;
+	}
+};
+
+extern LittleFSClass LittleFS;
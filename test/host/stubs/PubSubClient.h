@@ -0,0 +1,4 @@
+#pragma once
+#include <ESP8266WiFi.h>
+
+class PubSubClient {};
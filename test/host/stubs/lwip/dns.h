@@ -0,0 +1,7 @@
+#pragma once
+#include <stdint.h>
+
+typedef int8_t err_t;
+typedef struct {
+	uint32_t addr;
+} ip_addr_t;
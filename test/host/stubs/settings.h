@@ -0,0 +1,13 @@
+/*
+ * Host stand-in for the settings library, the host tests don't read or write the config.
+ */
+
+#pragma once
+
+template <class... Args>
+void setParameter(char* buffer, Args... args) {}
+
+template <class... Args>
+bool getParameter(char* buffer, Args... args) {
+	return false;
+}
@@ -0,0 +1,38 @@
+/*
+ * Minimal checks for the host tests, a failed check reports and the run exits non-zero.
+ */
+
+#pragma once
+#include <stdio.h>
+
+static int test_failures = 0;
+
+#define CHECK(COND) do { \
+	if (!(COND)) { \
+		printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #COND); \
+		test_failures++; \
+	} \
+} while (0)
+
+#define CHECK_EQ(A, B) do { \
+	long long check_a = (long long) (A), check_b = (long long) (B); \
+	if (check_a != check_b) { \
+		printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #A, #B, check_a, check_b); \
+		test_failures++; \
+	} \
+} while (0)
+
+#define CHECK_STR(A, B) do { \
+	if (strcmp((A), (B))) { \
+		printf("%s:%d: CHECK_STR(%s, %s) failed: \"%s\" != \"%s\"\n", __FILE__, __LINE__, #A, #B, (A), (B)); \
+		test_failures++; \
+	} \
+} while (0)
+
+#define RUN_TEST(TEST) do { \
+	int failures_before = test_failures; \
+	TEST(); \
+	printf("%s %s\n", (test_failures == failures_before) ? "ok  " : "FAIL", #TEST); \
+} while (0)
+
+#define TEST_RESULT() (test_failures ? 1 : 0)
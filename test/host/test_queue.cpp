@@ -0,0 +1,206 @@
+/*
+ * Project: Temperature Tick
+ *
+ * Author: Vereshchynskyi Nazar
+ * Email: verechnazar12@gmail.com
+ * Version: 1.0.0
+ * Date: 02.03.2025
+ *
+ * Host tests of the MqttQueue spill path against the in-memory LittleFS in stubs/.
+ */
+
+#include "data.h"
+#include "test.h"
+
+/* --- link seams --- */
+time_t SystemManager::getClockTime() {
+	return 0;
+}
+
+/* --- helpers --- */
+static uint32_t next_value = 0;
+
+static void pushMany(MqttQueue* queue, uint16_t n) {
+	char payload[12];
+
+	for (uint16_t i = 0;i < n;i++) {
+		snprintf(payload, sizeof(payload), "%u", next_value++);
+		queue->push("t", payload);
+	}
+}
+
+// pops everything and checks the values come out in order, returns the first one
+static int32_t drain(MqttQueue* queue) {
+	int32_t first = -1;
+	int32_t last = -1;
+	mqtt_message_t* message;
+
+	while ((message = queue->front()) != NULL) {
+		int32_t value = atoi(message->payload);
+
+		if (first < 0) {
+			first = value;
+		}
+		else if (value != last + 1) {
+			printf("  %d after %d\n", value, last);
+			test_failures++;
+		}
+
+		last = value;
+		queue->pop();
+	}
+
+	return first;
+}
+
+static void resetFs() {
+	fake_files.clear();
+	fake_fs_limit = 1 << 20;
+	fake_fs_writes = 0;
+	next_value = 0;
+}
+
+void testRamOnly() {
+	MqttQueue queue;
+	resetFs();
+
+	pushMany(&queue, MQTT_QUEUE_SIZE);
+	queue.tick();
+
+	CHECK_EQ(queue.getCount(), MQTT_QUEUE_SIZE);
+	CHECK_EQ(fake_fs_writes, 0);
+	CHECK_EQ(drain(&queue), 0);
+}
+
+void testSpillIsBatched() {
+	MqttQueue queue;
+	resetFs();
+
+	pushMany(&queue, MQTT_QUEUE_SIZE + MQTT_QUEUE_STAGING_SIZE - 1);
+
+	// push() only stages, nothing is written before tick()
+	CHECK_EQ(fake_fs_writes, 0);
+	CHECK_EQ(queue.getCount(), MQTT_QUEUE_SIZE + MQTT_QUEUE_STAGING_SIZE - 1);
+
+	queue.tick();
+	CHECK_EQ(fake_fs_writes, 0);
+
+	pushMany(&queue, 1);
+	queue.tick();
+	CHECK_EQ(fake_fs_writes, 1);
+	CHECK_EQ(queue.getSpillCount(), MQTT_QUEUE_STAGING_SIZE);
+
+	// a part batch waits for the interval
+	pushMany(&queue, 1);
+	queue.tick();
+	CHECK_EQ(fake_fs_writes, 1);
+
+	fake_millis += MQTT_QUEUE_FLUSH_INTERVAL;
+	queue.tick();
+	CHECK_EQ(fake_fs_writes, 2);
+	CHECK_EQ(queue.getSpillCount(), MQTT_QUEUE_STAGING_SIZE + 1);
+
+	CHECK_EQ(drain(&queue), 0);
+	CHECK_EQ(queue.getCount(), 0);
+	CHECK(!LittleFS.exists(MQTT_QUEUE_SPILL_PATH));
+}
+
+void testStagedMoveToRam() {
+	MqttQueue queue;
+	resetFs();
+
+	pushMany(&queue, MQTT_QUEUE_SIZE + 2);
+
+	// the ring drained before the batch filled up, the staged messages never touch flash
+	for (uint8_t i = 0;i < MQTT_QUEUE_SIZE;i++) {
+		queue.pop();
+	}
+
+	queue.tick();
+	fake_millis += MQTT_QUEUE_FLUSH_INTERVAL;
+	queue.tick();
+
+	CHECK_EQ(fake_fs_writes, 0);
+	CHECK_EQ(queue.getRamCount(), 2);
+	CHECK_EQ(drain(&queue), MQTT_QUEUE_SIZE);
+}
+
+void testFullFileDropsOldest() {
+	MqttQueue queue;
+	resetFs();
+	fake_fs_limit = 4 << 20; // the rewrite needs room for both files
+
+	pushMany(&queue, MQTT_QUEUE_SIZE);
+
+	for (uint16_t i = 0;i < MQTT_QUEUE_SPILL_MAX_COUNT + 40;i += MQTT_QUEUE_STAGING_SIZE) {
+		pushMany(&queue, MQTT_QUEUE_STAGING_SIZE);
+		queue.tick();
+	}
+
+	CHECK_EQ(queue.getSpillCount(), MQTT_QUEUE_SPILL_MAX_COUNT);
+	CHECK_EQ(queue.getDropped(), 40);
+
+	// past a quarter of skipped records the file is rewritten without them
+	for (uint16_t i = 0;i < MQTT_QUEUE_SPILL_MAX_COUNT / 4;i += MQTT_QUEUE_STAGING_SIZE) {
+		pushMany(&queue, MQTT_QUEUE_STAGING_SIZE);
+		queue.tick();
+	}
+
+	CHECK(fake_files[MQTT_QUEUE_SPILL_PATH]->size() < (MQTT_QUEUE_SPILL_MAX_COUNT + MQTT_QUEUE_SPILL_MAX_COUNT / 4) * sizeof(mqtt_message_t));
+	CHECK_EQ(queue.getDropped(), 40 + MQTT_QUEUE_SPILL_MAX_COUNT / 4);
+
+	// the RAM messages stay, the newest readings are all there
+	for (uint8_t i = 0;i < MQTT_QUEUE_SIZE;i++) {
+		CHECK_EQ(atoi(queue.front()->payload), i);
+		queue.pop();
+	}
+
+	CHECK_EQ(drain(&queue), next_value - MQTT_QUEUE_SPILL_MAX_COUNT);
+}
+
+void testFlashFullDropsOldestStaged() {
+	MqttQueue queue;
+	resetFs();
+	fake_fs_limit = 0;
+
+	pushMany(&queue, MQTT_QUEUE_SIZE + MQTT_QUEUE_STAGING_SIZE + 3);
+
+	CHECK_EQ(queue.getDropped(), 3);
+	CHECK_EQ(queue.getCount(), MQTT_QUEUE_SIZE + MQTT_QUEUE_STAGING_SIZE);
+
+	for (uint8_t i = 0;i < MQTT_QUEUE_SIZE;i++) {
+		queue.pop();
+	}
+	CHECK_EQ(drain(&queue), MQTT_QUEUE_SIZE + 3);
+}
+
+void testSaveAndBegin() {
+	MqttQueue queue;
+	resetFs();
+
+	pushMany(&queue, MQTT_QUEUE_SIZE + MQTT_QUEUE_STAGING_SIZE);
+	queue.tick();
+	pushMany(&queue, 2);
+	queue.pop();
+
+	// RAM, flash and the staged messages all go to the file, in order
+	queue.save();
+	CHECK_EQ(queue.getCount(), MQTT_QUEUE_SIZE + MQTT_QUEUE_STAGING_SIZE + 1);
+	CHECK_EQ(queue.getRamCount(), 0);
+
+	MqttQueue restored;
+	restored.begin();
+	CHECK_EQ(restored.getCount(), MQTT_QUEUE_SIZE + MQTT_QUEUE_STAGING_SIZE + 1);
+	CHECK_EQ(drain(&restored), 1);
+}
+
+int main() {
+	RUN_TEST(testRamOnly);
+	RUN_TEST(testSpillIsBatched);
+	RUN_TEST(testStagedMoveToRam);
+	RUN_TEST(testFullFileDropsOldest);
+	RUN_TEST(testFlashFullDropsOldestStaged);
+	RUN_TEST(testSaveAndBegin);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,123 @@
+/*
+ * Project: Temperature Tick
+ *
+ * Author: Vereshchynskyi Nazar
+ * Email: verechnazar12@gmail.com
+ * Version: 1.0.0
+ * Date: 02.03.2025
+ *
+ * Host tests of ReconnectPolicy, millis() and ESP.random() are the fakes in stubs/.
+ */
+
+#include "data.h"
+#include "test.h"
+
+void testFirstAttemptIsImmediate() {
+	ReconnectPolicy policy;
+
+	CHECK(policy.isReady());
+	CHECK_EQ(policy.getWaitTime(), 0);
+	CHECK_EQ(policy.getAttempts(), 0);
+}
+
+void testBackoffDoublesWithEqualJitter() {
+	ReconnectPolicy policy;
+	policy.setLimits(1000, 8000);
+
+	uint32_t backoff = 1000;
+
+	for (uint8_t i = 0;i < 6;i++) {
+		policy.attempt();
+		policy.fail();
+
+		// half of the delay is fixed, the other half random
+		uint32_t wait = policy.getWaitTime();
+		CHECK(wait >= backoff / 2);
+		CHECK(wait <= backoff);
+		CHECK(!policy.isReady());
+
+		fake_millis += wait;
+		CHECK(policy.isReady());
+
+		backoff = min(backoff * 2, (uint32_t) 8000);
+	}
+
+	CHECK_EQ(policy.getAttempts(), 6);
+	CHECK_EQ(policy.getTotalAttempts(), 6);
+}
+
+void testSuccessRecordsTimeToConnect() {
+	ReconnectPolicy policy;
+	policy.setLimits(1000, 8000);
+
+	uint32_t start = fake_millis;
+	policy.attempt();
+	policy.fail();
+	fake_millis += policy.getWaitTime();
+	policy.attempt();
+	fake_millis += 250;
+	policy.success();
+
+	CHECK_EQ(policy.getConnectTime(), fake_millis - start);
+	CHECK_EQ(policy.getConnects(), 1);
+	CHECK_EQ(policy.getAttempts(), 0);
+	CHECK_EQ(policy.getTotalAttempts(), 2);
+
+	// a new series starts from the minimum again
+	policy.attempt();
+	policy.fail();
+	CHECK(policy.getWaitTime() <= 1000);
+}
+
+void testRetryNow() {
+	ReconnectPolicy policy;
+
+	policy.attempt();
+	policy.fail();
+	CHECK(!policy.isReady());
+
+	policy.retryNow();
+	CHECK(policy.isReady());
+
+	// the backoff starts over as well
+	policy.attempt();
+	policy.fail();
+	CHECK(policy.getWaitTime() <= SEC_TO_MLS(RECONNECT_MIN_TIME));
+}
+
+void testLimits() {
+	ReconnectPolicy policy;
+
+	// a zero minimum would never wait, a maximum below the minimum is raised to it
+	policy.setLimits(0, 0);
+	policy.attempt();
+	policy.fail();
+	CHECK(policy.getWaitTime() >= 1);
+	CHECK(policy.getWaitTime() <= 2);
+}
+
+void testPrint() {
+	ReconnectPolicy policy;
+	char buffer[96];
+
+	policy.attempt();
+	CHECK_EQ(policy.print(buffer, sizeof(buffer)), strlen(buffer));
+	CHECK_STR(buffer, "{\"n\":1,\"total\":1,\"connects\":0,\"ttc\":0,\"wait\":0}");
+
+	// a short buffer is cut, not overrun
+	CHECK_EQ(policy.print(buffer, 8), 7);
+	CHECK_EQ(strlen(buffer), 7);
+}
+
+int main() {
+	fake_millis = 100000;
+
+	RUN_TEST(testFirstAttemptIsImmediate);
+	RUN_TEST(testBackoffDoublesWithEqualJitter);
+	RUN_TEST(testSuccessRecordsTimeToConnect);
+	RUN_TEST(testRetryNow);
+	RUN_TEST(testLimits);
+	RUN_TEST(testPrint);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,204 @@
+/*
+ * Project: Temperature Tick
+ *
+ * Author: Vereshchynskyi Nazar
+ * Email: verechnazar12@gmail.com
+ * Version: 1.0.0
+ * Date: 02.03.2025
+ *
+ * Host tests of the RelayManager schedule: parsing, printing and the compiled transitions.
+ * RelayManager is never begun, so the controllers stay idle and only the target is checked.
+ */
+
+#include "data.h"
+#include "test.h"
+
+#define MONDAY 1704067200 // 2024-01-01 00:00 UTC
+#define AT(DAY, HOUR, MINUTE) ((time_t) MONDAY + ((DAY) - 1) * 86400 + (HOUR) * 3600 + (MINUTE) * 60)
+
+/* --- link seams --- */
+static time_t fake_clock = 0;
+
+time_t SystemManager::getClockTime() {
+	return fake_clock;
+}
+SensorsManager* SystemManager::getSensorsManager() {
+	return NULL;
+}
+void SystemManager::saveSettingsRequest() {}
+
+uint8_t SensorsManager::getDS18B20Count() {
+	return 0;
+}
+float SensorsManager::getDS18B20T(uint8_t index) {
+	return 0;
+}
+uint8_t SensorsManager::getDS18B20Status(uint8_t index) {
+	return 0;
+}
+
+/* --- helpers --- */
+class TargetObserver : public IObserver {
+public:
+	void addObserver(IObserver* observer) override {}
+	bool handleEvent(const char* code, void* data, uint8_t type) override {
+		if (!strcmp(code, "/relay/data/target_t")) {
+			events++;
+		}
+
+		return true;
+	}
+
+	uint8_t events = 0;
+};
+
+static const char* print(RelayManager* relay) {
+	static char buffer[128];
+
+	relay->printSchedule(0, buffer, sizeof(buffer));
+	return buffer;
+}
+
+void testParseAndPrint() {
+	RelayManager relay;
+
+	relay.setSchedule(0, "12345@06:30=21.5 67@08:00=22;*@23:00=18");
+	CHECK_EQ(relay.getPeriodsCount(0), 3);
+	CHECK_STR(print(&relay), "12345@06:30=21.50 67@08:00=22.00 *@23:00=18.00");
+
+	// the printed text reads back to the same schedule
+	String text = print(&relay);
+	relay.setSchedule(0, &text);
+	CHECK_EQ(relay.getPeriodsCount(0), 3);
+	CHECK_STR(print(&relay), text.c_str());
+
+	relay.setSchedule(0, "  ;  ");
+	CHECK_EQ(relay.getPeriodsCount(0), 0);
+	CHECK_STR(print(&relay), "");
+}
+
+void testRejectsBadEntries() {
+	RelayManager relay;
+	const char* bad[] = {
+		"8@06:00=20",
+		"@06:00=20",
+		"1@24:00=20",
+		"1@06:60=20",
+		"1@06-00=20",
+		"1@06:00",
+		"1=20@06:00",
+		"1@06:00=400",
+		"1@06:00=",
+		"*@00:00=1 *@01:00=1 *@02:00=1 *@03:00=1 *@04:00=1 *@05:00=1 *@06:00=1 *@07:00=1 *@08:00=1",
+	};
+
+	relay.setSchedule(0, "1@06:00=20");
+
+	// a rejected text leaves the old schedule in place
+	for (uint8_t i = 0;i < sizeof(bad) / sizeof(bad[0]);i++) {
+		relay.setSchedule(0, bad[i]);
+
+		if (relay.getPeriodsCount(0) != 1 || strcmp(print(&relay), "1@06:00=20.00")) {
+			printf("  accepted \"%s\"\n", bad[i]);
+			test_failures++;
+		}
+	}
+
+	relay.setSchedule(0, (const char*) NULL);
+	relay.setSchedule(1, "1@06:00=21");
+	CHECK_STR(print(&relay), "1@06:00=20.00");
+}
+
+void testTargetFollowsSchedule() {
+	RelayManager relay;
+	TargetObserver observer;
+	relay.addObserver(&observer);
+
+	fake_clock = AT(1, 7, 0);
+	relay.setSchedule(0, "12345@06:30=21.5 67@08:00=22 *@23:00=18");
+
+	// the schedule is off until the flag is set
+	CHECK(!relay.getScheduleStatus(0));
+	CHECK_EQ(relay.getTargetT(0) * 100, DEFAULT_RELAY_THERM_T * 100);
+
+	relay.setScheduleFlag(0, true);
+	CHECK(relay.getScheduleStatus(0));
+	CHECK_EQ(relay.getTargetT(0) * 100, 2150);
+	CHECK_EQ(observer.events, 1);
+
+	// before the first transition of the week the last one of Sunday is in effect
+	fake_clock = AT(1, 5, 0);
+	relay.syncSchedule();
+	CHECK_EQ(relay.getTargetT(0) * 100, 1800);
+
+	fake_clock = AT(6, 9, 0);
+	relay.syncSchedule();
+	CHECK_EQ(relay.getTargetT(0) * 100, 2200);
+
+	fake_clock = AT(7, 23, 59);
+	relay.syncSchedule();
+	CHECK_EQ(relay.getTargetT(0) * 100, 1800);
+
+	// without a clock the fixed setpoint is used
+	fake_clock = 0;
+	relay.syncSchedule();
+	CHECK(!relay.getScheduleStatus(0));
+	CHECK_EQ(relay.getTargetT(0) * 100, DEFAULT_RELAY_THERM_T * 100);
+}
+
+void testLaterPeriodWinsTheSameMinute() {
+	RelayManager relay;
+
+	fake_clock = AT(3, 12, 0);
+	relay.setScheduleFlag(0, true);
+	relay.setSchedule(0, "*@10:00=19 3@10:00=23");
+	CHECK_EQ(relay.getTargetT(0) * 100, 2300);
+
+	fake_clock = AT(4, 12, 0);
+	relay.syncSchedule();
+	CHECK_EQ(relay.getTargetT(0) * 100, 1900);
+}
+
+void testTickMovesToTheNextTransition() {
+	RelayManager relay;
+
+	fake_clock = AT(2, 7, 59);
+	relay.setScheduleFlag(0, true);
+	relay.setSchedule(0, "*@08:00=22 *@22:00=17");
+	CHECK_EQ(relay.getTargetT(0) * 100, 1700);
+
+	// an override without a duration holds until the next transition
+	relay.setOverride(0, 25, 0);
+	CHECK_EQ(relay.getTargetT(0) * 100, 2500);
+
+	relay.tick();
+	CHECK_EQ(relay.getTargetT(0) * 100, 2500);
+
+	fake_clock = AT(2, 8, 0);
+	relay.tick();
+	CHECK(!relay.getOverrideFlag(0));
+	CHECK_EQ(relay.getTargetT(0) * 100, 2200);
+
+	// hours late, the place in the week is found again instead of stepping once
+	fake_clock = AT(3, 9, 0);
+	relay.tick();
+	CHECK_EQ(relay.getTargetT(0) * 100, 2200);
+
+	fake_clock = AT(3, 22, 0);
+	relay.tick();
+	CHECK_EQ(relay.getTargetT(0) * 100, 1700);
+}
+
+int main() {
+	// the transitions are computed in local time
+	setenv("TZ", "UTC0", 1);
+	tzset();
+
+	RUN_TEST(testParseAndPrint);
+	RUN_TEST(testRejectsBadEntries);
+	RUN_TEST(testTargetFollowsSchedule);
+	RUN_TEST(testLaterPeriodWinsTheSameMinute);
+	RUN_TEST(testTickMovesToTheNextTransition);
+
+	return TEST_RESULT();
+}
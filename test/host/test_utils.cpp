@@ -0,0 +1,223 @@
+/*
+ * Project: Temperature Tick
+ *
+ * Author: Vereshchynskyi Nazar
+ * Email: verechnazar12@gmail.com
+ * Version: 1.0.0
+ * Date: 02.03.2025
+ *
+ * Host tests of the hashing, parsing and formatting helpers in utils.cpp.
+ */
+
+#include "data.h"
+#include "test.h"
+
+static bool parseIntStr(const char* str, int32_t* value) {
+	return parseInt(str, strlen(str), value);
+}
+
+static bool parseFixedStr(const char* str, int32_t* value, uint8_t decimals) {
+	return parseFixed(str, strlen(str), value, decimals);
+}
+
+void testCrc32() {
+	// the standard check value of CRC-32/ISO-HDLC
+	CHECK_EQ(calcCrc32("123456789", 9), 0xCBF43926);
+	CHECK_EQ(calcCrc32("", 0), 0);
+	CHECK(calcCrc32("a", 1) != calcCrc32("b", 1));
+}
+
+void testHash() {
+	// FNV-1a 32 reference values
+	CHECK_EQ(calcHash(""), 2166136261UL);
+	CHECK_EQ(calcHash("a"), 0xE40C292C);
+	CHECK_EQ(calcHash("foobar"), 0xBF9CF968);
+}
+
+void testParseInt() {
+	int32_t value = 0;
+
+	CHECK(parseIntStr("0", &value));
+	CHECK_EQ(value, 0);
+	CHECK(parseIntStr("  42", &value));
+	CHECK_EQ(value, 42);
+	CHECK(parseIntStr("-17", &value));
+	CHECK_EQ(value, -17);
+	CHECK(parseIntStr("+5", &value));
+	CHECK_EQ(value, 5);
+
+	CHECK(parseIntStr("2147483647", &value));
+	CHECK_EQ(value, INT32_MAX);
+	CHECK(parseIntStr("-2147483647", &value));
+	CHECK_EQ(value, -INT32_MAX);
+
+	value = 7;
+	CHECK(!parseIntStr("2147483648", &value));
+	CHECK(!parseIntStr("99999999999", &value));
+	CHECK(!parseIntStr("", &value));
+	CHECK(!parseIntStr("-", &value));
+	CHECK(!parseIntStr("abc", &value));
+	CHECK_EQ(value, 7);
+
+	// only trailing spaces may follow the number
+	CHECK(parseIntStr("42  ", &value));
+	CHECK_EQ(value, 42);
+	value = 7;
+	CHECK(!parseIntStr("12abc", &value));
+	CHECK(!parseIntStr("1e3", &value));
+	CHECK(!parseIntStr("0x10", &value));
+	CHECK(!parseIntStr("1.5", &value));
+	CHECK(!parseIntStr("4 2", &value));
+	CHECK_EQ(value, 7);
+
+	// only the given length is read, payloads are not null terminated
+	CHECK(parseInt("123456", 3, &value));
+	CHECK_EQ(value, 123);
+	CHECK(parseInt("12\0abc", 6, &value));
+	CHECK_EQ(value, 12);
+
+	CHECK(!parseInt(NULL, 1, &value));
+	CHECK(!parseInt("1", 1, NULL));
+}
+
+void testParseBool() {
+	bool value = false;
+
+	CHECK(parseBool("true", 4, &value));
+	CHECK(value);
+	CHECK(parseBool("OFF", 3, &value));
+	CHECK(!value);
+	CHECK(parseBool("on", 2, &value));
+	CHECK(value);
+	CHECK(parseBool("0", 1, &value));
+	CHECK(!value);
+	CHECK(parseBool("1", 1, &value));
+	CHECK(value);
+
+	CHECK(!parseBool("yes", 3, &value));
+	CHECK(!parseBool("1abc", 4, &value));
+	CHECK(!parseBool("", 0, &value));
+}
+
+void testParseFixed() {
+	int32_t value = 0;
+
+	CHECK(parseFixedStr("21.5", &value, 2));
+	CHECK_EQ(value, 2150);
+	CHECK(parseFixedStr("-0.25", &value, 2));
+	CHECK_EQ(value, -25);
+	CHECK(parseFixedStr("21,5", &value, 2));
+	CHECK_EQ(value, 2150);
+	CHECK(parseFixedStr("7", &value, 3));
+	CHECK_EQ(value, 7000);
+	CHECK(parseFixedStr(".5", &value, 1));
+	CHECK_EQ(value, 5);
+	CHECK(parseFixedStr("12", &value, 0));
+	CHECK_EQ(value, 12);
+
+	// the whole part is bounded by INT32_MAX / 10^decimals
+	CHECK(parseFixedStr("21474836.47", &value, 2));
+	CHECK_EQ(value, INT32_MAX);
+	CHECK(!parseFixedStr("21474836.48", &value, 2));
+	CHECK(!parseFixedStr("21474837", &value, 2));
+	CHECK(!parseFixedStr("99999999999", &value, 0));
+
+	// zeros past the precision lose nothing, other digits and trailing garbage are rejected
+	CHECK(parseFixedStr("21.500 ", &value, 2));
+	CHECK_EQ(value, 2150);
+	CHECK(parseFixedStr("21.", &value, 2));
+	CHECK_EQ(value, 2100);
+	value = 7;
+	CHECK(!parseFixedStr("21.505", &value, 2));
+	CHECK(!parseFixedStr("21.5abc", &value, 2));
+	CHECK(!parseFixedStr("1e3", &value, 2));
+	CHECK(!parseFixedStr("0x10", &value, 2));
+	CHECK(!parseFixedStr("12.5", &value, 0));
+	CHECK(!parseFixedStr("1.2.3", &value, 2));
+	CHECK_EQ(value, 7);
+
+	CHECK(!parseFixedStr("", &value, 2));
+	CHECK(!parseFixedStr("-", &value, 2));
+	CHECK(!parseFixedStr(".", &value, 2));
+}
+
+void testFormatInt() {
+	char buffer[16];
+
+	CHECK_EQ(formatUint(buffer, sizeof(buffer), 0), 1);
+	CHECK_STR(buffer, "0");
+	CHECK_EQ(formatUint(buffer, sizeof(buffer), UINT32_MAX), 10);
+	CHECK_STR(buffer, "4294967295");
+	CHECK_EQ(formatInt(buffer, sizeof(buffer), INT32_MIN), 11);
+	CHECK_STR(buffer, "-2147483648");
+	CHECK_EQ(formatInt(buffer, sizeof(buffer), -5), 2);
+	CHECK_STR(buffer, "-5");
+
+	// a value that doesn't fit leaves an empty string
+	CHECK_EQ(formatUint(buffer, 3, 123), 0);
+	CHECK_STR(buffer, "");
+	CHECK_EQ(formatInt(buffer, 3, -12), 0);
+	CHECK_STR(buffer, "");
+	CHECK_EQ(formatUint(buffer, 4, 123), 3);
+	CHECK_STR(buffer, "123");
+}
+
+void testFormatFixed() {
+	char buffer[16];
+
+	CHECK_EQ(formatFixed(buffer, sizeof(buffer), 2150, 2), 5);
+	CHECK_STR(buffer, "21.50");
+	CHECK_EQ(formatFixed(buffer, sizeof(buffer), -5, 2), 5);
+	CHECK_STR(buffer, "-0.05");
+	CHECK_EQ(formatFixed(buffer, sizeof(buffer), 42, 0), 2);
+	CHECK_STR(buffer, "42");
+	CHECK_EQ(formatFixed(buffer, 5, 2150, 2), 0);
+	CHECK_STR(buffer, "");
+}
+
+void testFormatFloat() {
+	char buffer[16];
+
+	CHECK_EQ(formatFloat(buffer, sizeof(buffer), 21.5f, 2), 5);
+	CHECK_STR(buffer, "21.50");
+	CHECK_EQ(formatFloat(buffer, sizeof(buffer), -0.126f, 2), 5);
+	CHECK_STR(buffer, "-0.13");
+	CHECK_EQ(formatFloat(buffer, sizeof(buffer), 3.0f, 0), 1);
+	CHECK_STR(buffer, "3");
+
+	CHECK_EQ(formatFloat(buffer, sizeof(buffer), NAN, 2), 0);
+	CHECK_STR(buffer, "");
+	CHECK_EQ(formatFloat(buffer, sizeof(buffer), 1e10f, 2), 0);
+}
+
+void testFormatValue() {
+	char buffer[16];
+	bool flag = true;
+	int16_t number = -300;
+	float t = 19.25f;
+
+	CHECK_EQ(formatValue(buffer, sizeof(buffer), &flag, TYPE_BOOL, 2), 1);
+	CHECK_STR(buffer, "1");
+	CHECK_EQ(formatValue(buffer, sizeof(buffer), &number, TYPE_INT16_T, 2), 4);
+	CHECK_STR(buffer, "-300");
+	CHECK_EQ(formatValue(buffer, sizeof(buffer), &t, TYPE_FLOAT, 1), 4);
+	CHECK_STR(buffer, "19.3");
+	CHECK_EQ(formatValue(buffer, sizeof(buffer), (void*) "text", TYPE_STRING, 2), 4);
+	CHECK_STR(buffer, "text");
+	CHECK_EQ(formatValue(buffer, 4, (void*) "text", TYPE_STRING, 2), 0);
+	CHECK_EQ(formatValue(buffer, sizeof(buffer), NULL, TYPE_INT32_T, 2), 0);
+}
+
+int main() {
+	RUN_TEST(testCrc32);
+	RUN_TEST(testHash);
+	RUN_TEST(testParseInt);
+	RUN_TEST(testParseBool);
+	RUN_TEST(testParseFixed);
+	RUN_TEST(testFormatInt);
+	RUN_TEST(testFormatFixed);
+	RUN_TEST(testFormatFloat);
+	RUN_TEST(testFormatValue);
+
+	return TEST_RESULT();
+}